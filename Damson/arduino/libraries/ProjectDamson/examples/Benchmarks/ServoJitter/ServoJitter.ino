@@ -0,0 +1,186 @@
+/*
+ * Sketch     Servo pulse jitter benchmark
+ * Platform   Project Damson (Arduino Mega 2560)
+ * Brief      Measures the pulses of the servo driver with the input capture of timer 5.
+ *            All 18 channels run with fixed pulses while a 20 ms FlexiTimer2 service keeps the CPU
+ *            busy like the robot update does. The pulse width and the frame period of one channel
+ *            are captured at 62.5 ns resolution and summarized on the serial monitor (115200).
+ *            The third run also sets the pulse of channel 1 (timer 3) so that its fall meets the
+ *            fall of the measured channel, the worst case of two servo interrupts. Each report
+ *            counts the late edges of the driver.
+ * Note       1. Remove the servo cable from pin 22 (leg 1 hip), the servos do not need power.
+ *            2. Connect pin 22 to pin 48 (ICP5) with a jumper wire.
+ *            3. Upload and open the serial monitor. Each report covers 500 pulses, without the
+ *               load, with it, and with the load and colliding falls.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#ifndef ARDUINO_AVR_MEGA2560
+#error Wrong board. Please choose "Arduino/Genuino Mega or Mega 2560"
+#endif
+
+#include <FlexiTimer2.h>
+#include <ProjectDamsonServoDriver.h>
+
+const byte servoPins[ServoDriver::maxChannels] = { 22, 23, 24, 25, 26, 27, 28, 29, 30,
+                                                   31, 32, 33, 34, 35, 36, 37, 38, 39 };
+const float testPulse = 1500.25;    // us, not a whole microsecond on purpose
+const float collidePulse = 2000.25;
+const float timerOffset = 1111.11;  // us, the rises of timer 3 follow those of timer 1 by this
+const int sampleCount = 500;
+const unsigned long loadMicros = 6000;
+
+volatile unsigned int overflows = 0;
+volatile unsigned long riseTime = 0;
+volatile unsigned long lastRiseTime = 0;
+volatile bool isRising = true;
+
+volatile int samples = 0;
+volatile unsigned long widthMin, widthMax, periodMin, periodMax;
+volatile float widthSum, widthSquareSum;
+
+volatile bool isLoadOn = false;
+byte run = 0;
+
+void StartCapture()
+{
+  // Timer 5 free running at 16 MHz, capture rising edges on ICP5 first
+  TCCR5A = 0;
+  TCCR5B = _BV(ICES5) | _BV(CS50);
+  TCNT5 = 0;
+  TIFR5 = _BV(ICF5) | _BV(TOV5);
+  TIMSK5 = _BV(ICIE5) | _BV(TOIE5);
+}
+
+unsigned long CaptureTime()
+{
+  unsigned int count = ICR5;
+  unsigned int high = overflows;
+  // An overflow pending before this capture has not been counted yet
+  if ((TIFR5 & _BV(TOV5)) && count < 0x8000)
+    high++;
+  return ((unsigned long)high << 16) | count;
+}
+
+ISR(TIMER5_OVF_vect)
+{
+  overflows++;
+}
+
+ISR(TIMER5_CAPT_vect)
+{
+  unsigned long time = CaptureTime();
+
+  if (isRising)
+  {
+    if (lastRiseTime != 0 && samples < sampleCount)
+    {
+      unsigned long period = time - lastRiseTime;
+      periodMin = min(periodMin, period);
+      periodMax = max(periodMax, period);
+    }
+    lastRiseTime = time;
+    riseTime = time;
+    TCCR5B &= ~_BV(ICES5);
+  }
+  else
+  {
+    if (samples < sampleCount)
+    {
+      unsigned long width = time - riseTime;
+      widthMin = min(widthMin, width);
+      widthMax = max(widthMax, width);
+      widthSum += width;
+      widthSquareSum += (float)width * width;
+      samples++;
+    }
+    TCCR5B |= _BV(ICES5);
+  }
+  isRising = !isRising;
+}
+
+void UpdateService()
+{
+  // Same shape as the robot update, interrupts enabled and several milliseconds of work
+  sei();
+  if (!isLoadOn)
+    return;
+  unsigned long start = micros();
+  volatile float x = 1;
+  while (micros() - start < loadMicros)
+    x = sqrt(x + 1.5) * atan2(x, 2.0);
+}
+
+void ResetStatistics()
+{
+  noInterrupts();
+  samples = 0;
+  widthMin = periodMin = 0xFFFFFFFF;
+  widthMax = periodMax = 0;
+  widthSum = widthSquareSum = 0;
+  lastRiseTime = 0;
+  interrupts();
+  ServoDriver::ResetLateEdgeCount();
+}
+
+void Report()
+{
+  float mean = widthSum / sampleCount;
+  float deviation = sqrt(max(0.0, widthSquareSum / sampleCount - mean * mean));
+
+  const char *names[] = { "Load off", "Load on ", "Falls   " };
+  Serial.print(names[run]);
+  Serial.print("  width(us) mean ");
+  Serial.print(mean / 16, 3);
+  Serial.print(" min ");
+  Serial.print(widthMin / 16.0, 3);
+  Serial.print(" max ");
+  Serial.print(widthMax / 16.0, 3);
+  Serial.print(" sd ");
+  Serial.print(deviation / 16, 3);
+  Serial.print("  period(us) min ");
+  Serial.print(periodMin / 16.0, 3);
+  Serial.print(" max ");
+  Serial.print(periodMax / 16.0, 3);
+  Serial.print("  late edges ");
+  Serial.println(ServoDriver::GetLateEdgeCount());
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("Servo pulse jitter, pin 22 -> pin 48");
+
+  for (byte i = 0; i < ServoDriver::maxChannels; i++)
+  {
+    byte channel = ServoDriver::Attach(servoPins[i]);
+    ServoDriver::WriteMicroseconds(channel, testPulse);
+  }
+
+  FlexiTimer2::set(20, UpdateService);
+  FlexiTimer2::start();
+
+  StartCapture();
+}
+
+void SetRun(byte newRun)
+{
+  run = newRun;
+  isLoadOn = run > 0;
+  // Channel 0 is pin 22 on timer 1, channel 1 is on timer 3
+  bool isColliding = run == 2;
+  ServoDriver::WriteMicroseconds(0, isColliding ? collidePulse : testPulse);
+  ServoDriver::WriteMicroseconds(1, isColliding ? collidePulse - timerOffset : testPulse);
+  // The new pulses start with the next frame
+  delay(40);
+}
+
+void loop()
+{
+  ResetStatistics();
+  while (samples < sampleCount)
+    ;
+  Report();
+  SetRun(run < 2 ? run + 1 : 0);
+}
@@ -128,6 +128,9 @@ void IdleAnimations::DefaultTurnRightLeft()
 // For forward motion: leg moves forward (positive Y), then all legs push back (negative Y on body = forward motion)
 static void WaveStep(RobotAction* robotAction, int leg, float stepHeight, float legReach, float bodyPush)
 {
+  // 0. Sway the body so the other five feet keep it statically stable
+  robotAction->ShiftBodyForSwing(leg);
+
   // 1. Lift this leg
   robotAction->LegMoveToRelatively(leg, Point(0, 0, stepHeight));
 
@@ -145,6 +148,7 @@ static void WaveStep(RobotAction* robotAction, int leg, float stepHeight, float
 // Wave gait step for lateral movement
 static void WaveStepSide(RobotAction* robotAction, int leg, float stepHeight, float legReach, float bodyPush)
 {
+  robotAction->ShiftBodyForSwing(leg);
   robotAction->LegMoveToRelatively(leg, Point(0, 0, stepHeight));
   robotAction->LegMoveToRelatively(leg, Point(legReach, 0, 0));
   robotAction->LegMoveToRelatively(leg, Point(0, 0, -stepHeight));
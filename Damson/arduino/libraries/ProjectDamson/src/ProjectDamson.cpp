@@ -40,10 +40,11 @@ void ProjectDamson::ActiveMode()
     communication.robotAction.ActiveMode();
 }
 
-void ProjectDamson::SleepMode()
+bool ProjectDamson::SleepMode()
 {
-  if (!communication.commFunction)
-    communication.robotAction.SleepMode();
+  if (communication.commFunction)
+    return false;
+  return communication.robotAction.SleepMode();
 }
 
 void ProjectDamson::SwitchMode()
@@ -94,6 +95,19 @@ void ProjectDamson::Crawl(float x, float y, float angle)
     communication.robotAction.Crawl(x, y, angle);
 }
 
+void ProjectDamson::CrawlArc(float xCentre, float yCentre, float angle)
+{
+  if (!communication.commFunction)
+    communication.robotAction.CrawlArc(xCentre, yCentre, angle);
+}
+
+bool ProjectDamson::CrawlPath(const PathPose poses[], int count)
+{
+  if (!communication.commFunction)
+    return communication.robotAction.CrawlPath(poses, count);
+  return false;
+}
+
 void ProjectDamson::ChangeBodyHeight(float height)
 {
   if (!communication.commFunction)
@@ -182,7 +196,98 @@ void ProjectDamson::JumpWithSpeed(float speedMultiple)
 
 void ProjectDamson::SetServoAngle(int leg, int joint, int angle)
 {
+  communication.robotAction.robot.WakeUp();
   communication.robotAction.robot.SetServoAngle(leg, joint, angle);
 }
 
+bool ProjectDamson::SetServoPulseRange(int leg, int joint, unsigned int minPulse, unsigned int maxPulse)
+{
+  return communication.robotAction.robot.SetServoPulseRange(leg, joint, minPulse, maxPulse);
+}
+
+Robot::OutputCounts ProjectDamson::GetOutputCounts(bool reset)
+{
+  Robot::OutputCounts counts = communication.robotAction.robot.GetOutputCounts();
+  if (reset)
+    communication.robotAction.robot.ResetOutputCounts();
+  return counts;
+}
+
+float ProjectDamson::GetJointHeat(int leg, int joint)
+{
+  return communication.robotAction.robot.GetJointHeat(leg, joint);
+}
+
+float ProjectDamson::GetSpeedThrottle()
+{
+  return communication.robotAction.robot.GetSpeedThrottle();
+}
+
+float ProjectDamson::GetSupplyVoltage()
+{
+  return communication.robotAction.robot.power.voltage;
+}
+
+float ProjectDamson::GetSupplySpeed()
+{
+  return communication.robotAction.robot.GetSupplySpeed();
+}
+
+unsigned int ProjectDamson::GetDeratingCount()
+{
+  return communication.robotAction.robot.GetDeratingCount();
+}
+
+SupplyGovernor::Event ProjectDamson::GetLastDerating()
+{
+  return communication.robotAction.robot.GetLastDerating();
+}
+
+EnergyMeter::Report ProjectDamson::GetLastGaitCycle()
+{
+  return communication.robotAction.robot.GetLastGaitCycle();
+}
+
+EnergyMeter::Report ProjectDamson::GetGaitEnergy()
+{
+  return communication.robotAction.robot.GetGaitEnergy();
+}
+
+void ProjectDamson::ResetGaitEnergy()
+{
+  communication.robotAction.robot.ResetGaitEnergy();
+}
+
+float ProjectDamson::GetServoAngle(int leg, int joint)
+{
+  RobotJoint *robotJoint = communication.robotAction.robot.GetJoint(leg, joint);
+  if (robotJoint == nullptr)
+    return -1;
+  return robotJoint->servoAngleNow;
+}
+
+bool ProjectDamson::SetServoCurvePoint(int leg, int joint, int servoAngle, float correction)
+{
+  if (servoAngle % 30 != 0)
+    return false;
+  return communication.robotAction.robot.SetServoCurveCorrection(leg, joint, servoAngle / 30, correction);
+}
+
+float ProjectDamson::GetServoCurvePoint(int leg, int joint, int servoAngle)
+{
+  RobotJoint *robotJoint = communication.robotAction.robot.GetJoint(leg, joint);
+  if (robotJoint == nullptr || servoAngle % 30 != 0)
+    return 0;
+  return robotJoint->GetCurveCorrection(servoAngle / 30);
+}
+
+bool ProjectDamson::ClearServoCurve(int leg, int joint)
+{
+  RobotJoint *robotJoint = communication.robotAction.robot.GetJoint(leg, joint);
+  if (robotJoint == nullptr)
+    return false;
+  robotJoint->ClearCurve();
+  return true;
+}
+
 #endif
@@ -16,6 +16,7 @@
 
 #include "ProjectDamsonComm.h"
 #include "ProjectDamsonIdle.h"
+#include "ProjectDamsonFootstep.h"
 
 class ProjectDamson
 {
@@ -68,10 +69,13 @@ public:
 
  /*
   * Brief     Deactivate the robot, this mode is more power saving
+  *           The body pose is cleared and the body lowered to the ground, then the servos are
+  *           detached and their power is switched off. The next action attaches them again
+  *           first, within 2 seconds.
   * Param     None
-  * Retval    None
+  * Retval    false if the body could not be lowered, the servos stay powered then
   * -----------------------------------------------------------------------------------------------*/
-  void SleepMode();
+  bool SleepMode();
 
  /*
   * Brief     Switch between active and sleep mode
@@ -132,6 +136,29 @@ public:
   * -----------------------------------------------------------------------------------------------*/
   void Crawl(float x, float y, float angle);
 
+ /*
+  * Brief     Crawl along an arc
+  *           Feet follow circles around the turn centre, so a curved path is walked in one gait
+  *           loop instead of alternating crawl and turn. The angle is reduced if the farthest
+  *           foot would have to step further than a normal crawl.
+  *           Rotate will only execute 1/steps for each call, like Crawl().
+  * Param     xCentre, yCentre    The turn centre relative to the body
+  *           angle               The angle want to rotate around the turn centre
+  * Retval    None
+  * -----------------------------------------------------------------------------------------------*/
+  void CrawlArc(float xCentre, float yCentre, float angle);
+
+ /*
+  * Brief     Crawl along a short path
+  *           Every foothold is planned before the first step, each swing leg lands where the
+  *           following steps need it, so the steps chain together. Steps are shortened where a
+  *           foothold can not be reached. The whole path is walked in one call.
+  * Param     poses     Body poses (x, y, angle) relative to the start, same units as Crawl()
+  *           count     Number of poses, up to 8
+  * Retval    Whether the path was walked
+  * -----------------------------------------------------------------------------------------------*/
+  bool CrawlPath(const PathPose poses[], int count);
+
  /*
   * Brief     Change body height
   * Param     height    The height want to change
@@ -141,6 +168,7 @@ public:
 
  /*
   * Brief     Move body
+  *           z is relative to the height set by ChangeBodyHeight(), see TwistBody()
   * Param     x, y, z   The direction and distance want body to move
   * Retval    None
   * -----------------------------------------------------------------------------------------------*/
@@ -155,6 +183,10 @@ public:
 
  /*
   * Brief     Twist body
+  *           The pose is kept while crawling until InitialState() or another twist, so walking
+  *           does not return the body to neutral first.
+  *           zMove is relative to the height set by ChangeBodyHeight(). The body stays 0 ~ 45 mm
+  *           above the default height, so it can be lowered as far as the default height.
   * Param     xMove, yMove, zMove           The direction and distance want body to move
   *           xRotate, yRotate, zRotate     The direction and degree want body to rotate
   * Retval    None
@@ -228,9 +260,98 @@ public:
   * Param     angle   Servo angle (0-180)
   * Retval    None
   * Warning   Bypasses safety limits! Use with caution.
+  *           Wakes the robot up first, blocking until the servos are attached.
   * -----------------------------------------------------------------------------------------------*/
   void SetServoAngle(int leg, int joint, int angle);
 
+ /*
+  * Brief     Set the pulse widths of servo angle 0 and 180 of one servo, saved to EEPROM
+  * Param     leg       Leg number (1-6)
+  * Param     joint     Joint: 0=A(Hip), 1=B(Femur), 2=C(Tibia)
+  * Param     minPulse  Pulse width of 0 degree (us), default 544
+  * Param     maxPulse  Pulse width of 180 degree (us), default 2400
+  * Retval    Whether the range is valid (400~2600 us, min below max)
+  * -----------------------------------------------------------------------------------------------*/
+  bool SetServoPulseRange(int leg, int joint, unsigned int minPulse, unsigned int maxPulse);
+
+ /*
+  * Brief     Correct one point of the calibration curve of one servo, saved to EEPROM
+  *           The curve has points at servo angles 30, 60, 90, 120 and 150 between the ends of
+  *           the pulse range. Use it where a servo is not linear, after setting the pulse range.
+  * Param     leg         Leg number (1-6)
+  * Param     joint       Joint: 0=A(Hip), 1=B(Femur), 2=C(Tibia)
+  * Param     servoAngle  Servo angle of the point (30, 60, 90, 120 or 150)
+  * Param     correction  Pulse correction (us), -63.5~63.5, 0 removes it
+  * Retval    Whether the correction is valid, the pulse must still rise with the angle
+  * -----------------------------------------------------------------------------------------------*/
+  bool SetServoCurvePoint(int leg, int joint, int servoAngle, float correction);
+
+ /*
+  * Brief     Correction of one point of the calibration curve of one servo
+  * Param     leg, joint, servoAngle  As in SetServoCurvePoint()
+  * Retval    Pulse correction (us), 0 for no correction or no such point
+  * -----------------------------------------------------------------------------------------------*/
+  float GetServoCurvePoint(int leg, int joint, int servoAngle);
+
+ /*
+  * Brief     Remove every correction of the calibration curve of one servo, saved to EEPROM
+  *           The servo is linear over its pulse range again.
+  * Param     leg, joint  As in SetServoCurvePoint()
+  * Retval    Whether there is such a joint
+  * -----------------------------------------------------------------------------------------------*/
+  bool ClearServoCurve(int leg, int joint);
+
+ /*
+  * Brief     Inverse kinematics solves and servo writes done and skipped as unchanged
+  * Param     reset   Start counting again after reading
+  * Retval    The counts since start or the last reset
+  * -----------------------------------------------------------------------------------------------*/
+  Robot::OutputCounts GetOutputCounts(bool reset = false);
+
+ /*
+  * Brief     Estimated heat of one servo from its recent motion and load
+  * Param     leg       Leg number (1-6)
+  * Param     joint     Joint: 0=A(Hip), 1=B(Femur), 2=C(Tibia)
+  * Retval    Share of the heat budget, 0 when cold. Moves slow down above 0.8
+  * -----------------------------------------------------------------------------------------------*/
+  float GetJointHeat(int leg, int joint);
+
+ /*
+  * Brief     Speed factor of moves for the hottest servo, 1 when no servo is near its budget
+  * -----------------------------------------------------------------------------------------------*/
+  float GetSpeedThrottle();
+
+ /*
+  * Brief     Supply voltage and the speed factor of moves for it
+  *           Moves slow down while the supply is below 7 V or sags under load
+  * -----------------------------------------------------------------------------------------------*/
+  float GetSupplyVoltage();
+  float GetSupplySpeed();
+
+ /*
+  * Brief     Derating events, each a stretch of time the moves were slowed down for the supply
+  * Retval    The count since start, or the latest event
+  * -----------------------------------------------------------------------------------------------*/
+  unsigned int GetDeratingCount();
+  SupplyGovernor::Event GetLastDerating();
+
+ /*
+  * Brief     Estimated energy of the crawl, from the supply voltage and the modelled servo current
+  *           A loop is complete every 2, 4 or 6 steps, by the action group
+  * Retval    The last loop, or every loop since start or the last reset
+  * -----------------------------------------------------------------------------------------------*/
+  EnergyMeter::Report GetLastGaitCycle();
+  EnergyMeter::Report GetGaitEnergy();
+  void ResetGaitEnergy();
+
+ /*
+  * Brief     Servo angle a joint is at now
+  * Param     leg     1~6
+  *           joint   0 hip, 1 femur, 2 tibia
+  * Retval    The angle (degree), or -1 for no such joint
+  * -----------------------------------------------------------------------------------------------*/
+  float GetServoAngle(int leg, int joint);
+
   // Idle animation system - see ProjectDamsonIdle.h for full API
   IdleAnimations idle;
 
@@ -10,6 +10,17 @@
 
 #include "ProjectDamsonBasic.h"
 #include "ProjectDamsonLimits.h"
+#include "ProjectDamsonStability.h"
+#include "ProjectDamsonFootstep.h"
+
+volatile unsigned int Power::samplingReading = 0;
+
+#if !defined(DAMSON_HOST_SIM)
+ISR(ADC_vect)
+{
+  Power::samplingReading = ADC;
+}
+#endif
 
 Power::Power() {}
 
@@ -19,8 +30,22 @@ void Power::Set(float adcReference, float samplingProportion, bool powerGroupAut
   this->samplingProportion = samplingProportion;
   this->powerGroupAutoSwitch = powerGroupAutoSwitch;
 
-  for (int i = 0; i < samplingSize; i++)
-    samplingData[i] = 0;
+  // Start from the first reading, so the groups need not wait for the averages to fill up
+  unsigned int reading = analogRead(samplingPin);
+  samplingReading = reading;
+  // The earlier readings are the same, the newest of them is the only one the maximum needs
+  samplingIndex = samplingSize;
+  peakQueueFront = 0;
+  peakQueueCount = 1;
+  peakQueueReading[0] = reading;
+  peakQueueIndex[0] = samplingIndex - 1;
+  for (int i = 0; i < samplingPeakSize; i++)
+    samplingPeakData[i] = reading;
+  samplingPeakSum = reading * samplingPeakSize;
+  this->voltage = reading * adcReference / 1023 / samplingProportion;
+  readingVoltage = voltage;
+
+  StartSampling();
 
   pinMode(powerGroup1Pin, OUTPUT);
   pinMode(powerGroup2Pin, OUTPUT);
@@ -47,17 +72,20 @@ void Power::Update()
   {
     if (!powerGroup1State)
     {
-      SetPowerGroupState(1, true);
+      if (powerGroupLimit >= 1)
+        SetPowerGroupState(1, true);
       return;
     }
     else if (!powerGroup2State)
     {
-      SetPowerGroupState(2, true);
+      if (powerGroupLimit >= 2)
+        SetPowerGroupState(2, true);
       return;
     }
     else if (!powerGroup3State)
     {
-      SetPowerGroupState(3, true);
+      if (powerGroupLimit >= 3)
+        SetPowerGroupState(3, true);
       return;
     }
   }
@@ -81,29 +109,102 @@ void Power::Update()
   }
 }
 
-void Power::Sampling()
+void Power::SetPowerGroupLimit(byte group)
+{
+  powerGroupLimit = group;
+  for (byte i = group + 1; i <= 3; i++)
+    if (IsPowerGroupOn(i))
+      SetPowerGroupState(i, false);
+}
+
+bool Power::IsPowerGroupOn(byte group)
+{
+  switch (group)
+  {
+  case 1:
+    return powerGroup1State;
+  case 2:
+    return powerGroup2State;
+  case 3:
+    return powerGroup3State;
+  }
+  return false;
+}
+
+int Power::ReadAnalog(byte pin)
 {
-  float voltage = analogRead(samplingPin) * adcReference / 1023 / samplingProportion;
+  if (!isSampling)
+    return analogRead(pin);
 
-  samplingData[samplingDataCounter++] = voltage;
-  if (samplingDataCounter == samplingSize)
-    samplingDataCounter = 0;
+#if defined(DAMSON_HOST_SIM)
+  return analogRead(pin);
+#else
+  // Stop free running and let the conversion in progress finish, analogRead() waits for ADSC
+  ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+  while (ADCSRA & _BV(ADSC))
+    ;
+  int value = analogRead(pin);
+  // Select the supply voltage again, with the reference analogRead() uses
+  analogRead(samplingPin);
+  StartSampling();
+  return value;
+#endif
+}
 
-  float peakVoltage = 0;
-  for (int i = 0; i < samplingSize; i++)
-    if (peakVoltage < samplingData[i])
-      peakVoltage = samplingData[i];
+void Power::StartSampling()
+{
+  isSampling = true;
+#if !defined(DAMSON_HOST_SIM)
+  // analogRead() left the reference and the channel of samplingPin in ADMUX, keep converting it
+  // in free running mode, each result raises the ADC interrupt (about every 104 us)
+  ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0));
+  ADCSRA |= _BV(ADATE) | _BV(ADIE) | _BV(ADSC);
+#endif
+}
 
-  samplingPeakData[samplingPeakDataCounter++] = peakVoltage;
-  if (samplingPeakDataCounter == samplingPeakSize)
-    samplingPeakDataCounter = 0;
+void Power::Sampling()
+{
+#if defined(DAMSON_HOST_SIM)
+  unsigned int reading = analogRead(samplingPin);
+#else
+  uint8_t oldSREG = SREG;
+  cli();
+  unsigned int reading = samplingReading;
+  SREG = oldSREG;
+#endif
 
-  float averagePeakVoltage = 0;
-  for (int i = 0; i < samplingPeakSize; i++)
-    averagePeakVoltage += samplingPeakData[i];
-  averagePeakVoltage /= samplingPeakSize;
+  AddReading(reading);
+  readingVoltage = reading * adcReference / 1023 / samplingProportion;
+  voltage = (float)samplingPeakSum / samplingPeakSize * adcReference / 1023 / samplingProportion;
+}
+
+void Power::AddReading(unsigned int reading)
+{
+  // Drop the front once it is out of the window, this keeps room for the new reading
+  if (peakQueueCount > 0 && (unsigned int)(samplingIndex - peakQueueIndex[peakQueueFront]) >= samplingSize)
+  {
+    peakQueueFront = (peakQueueFront + 1) % samplingSize;
+    peakQueueCount--;
+  }
 
-  this->voltage = averagePeakVoltage;
+  // Readings not above the new one can never be the maximum again
+  while (peakQueueCount > 0)
+  {
+    byte back = (peakQueueFront + peakQueueCount - 1) % samplingSize;
+    if (peakQueueReading[back] > reading)
+      break;
+    peakQueueCount--;
+  }
+  byte back = (peakQueueFront + peakQueueCount) % samplingSize;
+  peakQueueReading[back] = reading;
+  peakQueueIndex[back] = samplingIndex++;
+  peakQueueCount++;
+
+  unsigned int peak = peakQueueReading[peakQueueFront];
+  samplingPeakSum += peak - samplingPeakData[samplingPeakDataCounter];
+  samplingPeakData[samplingPeakDataCounter] = peak;
+  if (++samplingPeakDataCounter == samplingPeakSize)
+    samplingPeakDataCounter = 0;
 }
 
 void Power::SetPowerGroupState(int group, bool state)
@@ -168,6 +269,23 @@ void RobotJoint::Set(int servoPin, float jointZero, bool jointDir, float jointMi
   offsetInt = offsetInt / 2 * ((offsetInt % 2) ? 1 : -1);
   float offset = offsetInt * 0.01;
   this->offset = offset;
+
+  pulseRangeAddress = EepromAddresses::servoPulseRange + (offsetAddress - EepromAddresses::servo22) * 2;
+  unsigned int minPulse = EEPROM.read(pulseRangeAddress) * 256 + EEPROM.read(pulseRangeAddress + 1);
+  unsigned int maxPulse = EEPROM.read(pulseRangeAddress + 2) * 256 + EEPROM.read(pulseRangeAddress + 3);
+  // Erased EEPROM reads 0xFFFF and keeps the default range
+  if (CheckPulseRange(minPulse, maxPulse))
+  {
+    this->minPulse = minPulse;
+    this->maxPulse = maxPulse;
+  }
+
+  curveAddress = EepromAddresses::servoCurve + (offsetAddress - EepromAddresses::servo22) * 3;
+  if (EEPROM.read(curveAddress) == curveValidMark)
+  {
+    for (byte i = 0; i < curveCorrections; i++)
+      curveCorrection[i] = (int8_t)EEPROM.read(curveAddress + 1 + i);
+  }
 }
 
 void RobotJoint::SetOffset(float offset)
@@ -193,10 +311,99 @@ void RobotJoint::SetOffsetEnableState(bool state)
   isOffsetEnable = state;
 }
 
+bool RobotJoint::SetPulseRange(unsigned int minPulse, unsigned int maxPulse)
+{
+  ServoCurve curve;
+  if (!CheckPulseRange(minPulse, maxPulse) || !GetCurve(curve, minPulse, maxPulse, curveCorrection))
+    return false;
+
+  EEPROM.write(pulseRangeAddress, minPulse / 256);
+  EEPROM.write(pulseRangeAddress + 1, minPulse % 256);
+  EEPROM.write(pulseRangeAddress + 2, maxPulse / 256);
+  EEPROM.write(pulseRangeAddress + 3, maxPulse % 256);
+  this->minPulse = minPulse;
+  this->maxPulse = maxPulse;
+  ServoDriver::SetPulseCurve(servoChannel, curve);
+  return true;
+}
+
+bool RobotJoint::SetCurveCorrection(byte knot, float correction)
+{
+  if (knot < 1 || knot > curveCorrections)
+    return false;
+
+  long ticks = lround(correction * ServoDriver::ticksPerMicrosecond);
+  if (ticks < -127 || ticks > 127)
+    return false;
+
+  int8_t newCorrection[curveCorrections];
+  memcpy(newCorrection, curveCorrection, sizeof(newCorrection));
+  newCorrection[knot - 1] = ticks;
+
+  ServoCurve curve;
+  if (!GetCurve(curve, minPulse, maxPulse, newCorrection))
+    return false;
+
+  memcpy(curveCorrection, newCorrection, sizeof(curveCorrection));
+  SaveCurve();
+  ServoDriver::SetPulseCurve(servoChannel, curve);
+  return true;
+}
+
+float RobotJoint::GetCurveCorrection(byte knot)
+{
+  if (knot < 1 || knot > curveCorrections)
+    return 0;
+  return (float)curveCorrection[knot - 1] / ServoDriver::ticksPerMicrosecond;
+}
+
+void RobotJoint::ClearCurve()
+{
+  memset(curveCorrection, 0, sizeof(curveCorrection));
+  SaveCurve();
+  ServoDriver::SetPulseRange(servoChannel, minPulse, maxPulse);
+}
+
+bool RobotJoint::GetCurve(ServoCurve &curve, unsigned int minPulse, unsigned int maxPulse, const int8_t correction[curveCorrections])
+{
+  unsigned int minTicks = minPulse * ServoDriver::ticksPerMicrosecond;
+  unsigned int maxTicks = maxPulse * ServoDriver::ticksPerMicrosecond;
+
+  curve.SetLinear(minTicks, maxTicks);
+  unsigned int knotTicks[ServoCurve::knots];
+  for (byte i = 0; i < ServoCurve::knots; i++)
+  {
+    knotTicks[i] = curve.GetTicks(i * ServoCurve::segmentCentidegrees);
+    if (i > 0 && i <= curveCorrections)
+      knotTicks[i] += correction[i - 1];
+  }
+  knotTicks[ServoCurve::knots - 1] = maxTicks;
+  return curve.Set(knotTicks);
+}
+
+void RobotJoint::SaveCurve()
+{
+  EEPROM.write(curveAddress, curveValidMark);
+  for (byte i = 0; i < curveCorrections; i++)
+    EEPROM.write(curveAddress + 1 + i, (byte)curveCorrection[i]);
+}
+
+bool RobotJoint::CheckPulseRange(unsigned int minPulse, unsigned int maxPulse)
+{
+  return minPulse >= ServoDriver::minPulse && maxPulse <= ServoDriver::maxPulse && minPulse < maxPulse;
+}
+
 void RobotJoint::RotateToDirectly(float jointAngle)
+{
+  int servoCentidegrees;
+  if (GetServoCentidegrees(jointAngle, servoCentidegrees))
+    RotateToServoCentidegrees(jointAngle, servoCentidegrees);
+}
+
+bool RobotJoint::GetServoCentidegrees(float jointAngle, int &servoCentidegrees)
 {
   if (!CheckJointAngle(jointAngle))
-    return;
+    return false;
 
   float servoAngle;
 
@@ -210,25 +417,28 @@ void RobotJoint::RotateToDirectly(float jointAngle)
   while (servoAngle < 0)
     servoAngle += 360;
   if (servoAngle > 180)
-    return;
+    return false;
 
   // Apply global servo limits (MG90S servos don't reliably reach 0 or 180)
-  servoAngle = GlobalServoLimits::clamp((int)servoAngle);
+  // From here to the pulse width the angle is kept in 0.01 degree, so small moves are not lost
+  servoCentidegrees = GlobalServoLimits::clampCentidegrees((int)(servoAngle * ServoDriver::centidegreesPerDegree + 0.5));
+  return true;
+}
 
-  if (isFirstRotate)
-  {
-    isFirstRotate = false;
-    servo.attach(servoPin);
-    servo.write(servoAngle);
-    delay(firstRotateDelay);
-  }
-  else
-  {
-    servo.write(servoAngle);
-  }
+void RobotJoint::RotateToServoCentidegrees(float jointAngle, int servoCentidegrees)
+{
+  WriteServo(servoCentidegrees);
 
   jointAngleNow = jointAngle;
-  servoAngleNow = servoAngle;
+  servoAngleNow = (float)servoCentidegrees / ServoDriver::centidegreesPerDegree;
+}
+
+float RobotJoint::GetConstrainedAngle(float jointAngle, int servoCentidegrees, int constrainedCentidegrees)
+{
+  // Shifted by the difference rather than mapped back, so the offset and the wrap to 0 - 360 drop out
+  if (constrainedCentidegrees == servoCentidegrees)
+    return jointAngle;
+  return jointAngle + (jointDir ? 1 : -1) * (float)(constrainedCentidegrees - servoCentidegrees) / ServoDriver::centidegreesPerDegree;
 }
 
 void RobotJoint::RotateToServoAngle(int servoAngle)
@@ -238,20 +448,76 @@ void RobotJoint::RotateToServoAngle(int servoAngle)
   if (servoAngle < 0 || servoAngle > 180)
     return;
 
+  WriteServo(servoAngle * ServoDriver::centidegreesPerDegree);
+
+  servoAngleNow = servoAngle;
+  jointAngleNow = GetJointAngle(servoAngle);
+}
+
+void RobotJoint::Enable()
+{
+  isEnabled = true;
+  if (servoCentidegreesNow < 0)
+    return;
+
+  if (servoCentidegreesWritten >= 0 && servoCentidegreesWritten != servoCentidegreesNow)
+  {
+    rampCentidegrees = servoCentidegreesWritten;
+    isRamping = true;
+    OutputServo(rampCentidegrees);
+    return;
+  }
+  OutputServo(servoCentidegreesNow);
+}
+
+void RobotJoint::UpdateRamp()
+{
+  if (!isRamping)
+    return;
+
+  // Follows the goal, which the moves keep changing meanwhile
+  int goal = servoCentidegreesNow;
+  rampCentidegrees = goal > rampCentidegrees ? min(goal, rampCentidegrees + firstMoveStep) : max(goal, rampCentidegrees - firstMoveStep);
+  if (rampCentidegrees == goal)
+    isRamping = false;
+  OutputServo(rampCentidegrees);
+}
+
+void RobotJoint::Disable()
+{
+  // The pulse is kept in servoCentidegreesNow for Enable()
+  isEnabled = false;
+  isRamping = false;
+  ServoDriver::Detach(servoChannel);
+}
+
+void RobotJoint::WriteServo(int servoCentidegrees)
+{
+  servoCentidegreesNow = servoCentidegrees;
+  if (!isEnabled || isRamping)
+    return;
+  OutputServo(servoCentidegrees);
+}
+
+void RobotJoint::OutputServo(int servoCentidegrees)
+{
+  servoCentidegreesWritten = servoCentidegrees;
   if (isFirstRotate)
   {
     isFirstRotate = false;
-    servo.attach(servoPin);
-    servo.write(servoAngle);
-    delay(firstRotateDelay);
+    servoChannel = ServoDriver::Attach(servoPin);
+    // Curves that no longer fit the pulse range fall back to the straight line
+    ServoCurve curve;
+    if (GetCurve(curve, minPulse, maxPulse, curveCorrection))
+      ServoDriver::SetPulseCurve(servoChannel, curve);
+    else
+      ServoDriver::SetPulseRange(servoChannel, minPulse, maxPulse);
+    ServoDriver::WriteCentidegrees(servoChannel, servoCentidegrees);
   }
   else
   {
-    servo.write(servoAngle);
+    ServoDriver::WriteCentidegrees(servoChannel, servoCentidegrees);
   }
-
-  servoAngleNow = servoAngle;
-  jointAngleNow = GetJointAngle(servoAngle);
 }
 
 float RobotJoint::GetJointAngle(float servoAngle)
@@ -281,6 +547,12 @@ void RobotLeg::Set(float xOrigin, float yOrigin, RobotShape robotShape)
   this->robotShape = robotShape;
 }
 
+void RobotLeg::SetNumber(byte number)
+{
+  this->number = number;
+  applyConstraints = LimitsEngine::getApply(number);
+}
+
 void RobotLeg::SetOffsetEnableState(bool state)
 {
   jointA.SetOffsetEnableState(state);
@@ -334,9 +606,36 @@ void RobotLeg::CalculateAngle(Point point, float &alpha, float &beta, float &gam
   CalculateAngle(point.x, point.y, point.z, alpha, beta, gamma);
 }
 
+void RobotLeg::CalculateLinks(float alpha, float beta, float gamma, LegLinks &links)
+{
+  // transform angle to radian
+  alpha = alpha * PI / 180;
+  beta = beta * PI / 180;
+  gamma = gamma * PI / 180;
+  // u-v coordinates of the hip, femur, tibia and foot, as in CalculatePoint()
+  float u[LegLinks::joints] = { 0, robotShape.d, robotShape.d + robotShape.e * sin(beta), 0 };
+  float v[LegLinks::joints] = { 0, robotShape.c, robotShape.c + robotShape.e * cos(beta), 0 };
+  u[3] = u[2] + robotShape.f * sin(gamma - beta);
+  v[3] = v[2] - robotShape.f * cos(gamma - beta);
+
+  float cosAlpha = cos(alpha);
+  float sinAlpha = sin(alpha);
+  for (byte i = 0; i < LegLinks::joints; i++)
+  {
+    links.x[i] = xOrigin + u[i] * cosAlpha;
+    links.y[i] = yOrigin + u[i] * sinAlpha;
+    links.z[i] = v[i];
+  }
+}
+
 bool RobotLeg::CheckPoint(Point point)
 {
   float alpha, beta, gamma;
+  return CheckPoint(point, alpha, beta, gamma);
+}
+
+bool RobotLeg::CheckPoint(Point point, float &alpha, float &beta, float &gamma)
+{
   CalculateAngle(point, alpha, beta, gamma);
   if (CheckAngle(alpha, beta, gamma))
   {
@@ -373,7 +672,11 @@ void RobotLeg::MoveToRelatively(Point point)
 void RobotLeg::WaitUntilFree()
 {
   while (isBusy)
-    ;
+  {
+#if defined(DAMSON_HOST_SIM)
+    HostSimWait();
+#endif
+  }
 }
 
 void RobotLeg::ServosRotateTo(float angleA, float angleB, float angleC)
@@ -388,11 +691,24 @@ void RobotLeg::ServosRotateTo(float angleA, float angleB, float angleC)
   MoveTo(point);
 }
 
+volatile unsigned long RobotLeg::solveCount = 0;
+volatile unsigned long RobotLeg::skippedSolveCount = 0;
+
 void RobotLeg::MoveToDirectly(Point point)
 {
-  float alpha, beta, gamma;
-  CalculateAngle(point, alpha, beta, gamma);
-  RotateToDirectly(alpha, beta, gamma);
+  // Held feet and finished moves ask for the same point every tick, the angles are the same too
+  if (isSolved && point.x == solvedPoint.x && point.y == solvedPoint.y && point.z == solvedPoint.z)
+  {
+    skippedSolveCount++;
+  }
+  else
+  {
+    CalculateAngle(point, solvedAlpha, solvedBeta, solvedGamma);
+    solvedPoint = point;
+    isSolved = true;
+    solveCount++;
+  }
+  RotateToDirectly(solvedAlpha, solvedBeta, solvedGamma);
 }
 
 void RobotLeg::MoveToDirectlyRelatively(Point point)
@@ -401,11 +717,36 @@ void RobotLeg::MoveToDirectlyRelatively(Point point)
   MoveToDirectly(point);
 }
 
+int RobotLeg::hipServoCentidegrees[6] = {};
+
 void RobotLeg::RotateToDirectly(float alpha, float beta, float gamma)
 {
-  jointC.RotateToDirectly(gamma);
-  jointB.RotateToDirectly(beta);
-  jointA.RotateToDirectly(alpha);
+  int servoA, servoB, servoC;
+  bool isValidA = jointA.GetServoCentidegrees(alpha, servoA);
+  bool isValidB = jointB.GetServoCentidegrees(beta, servoB);
+  bool isValidC = jointC.GetServoCentidegrees(gamma, servoC);
+
+  // The constraints relate the three joints, so they are only applied to complete solutions
+  // The joint angles and the point follow the servo angles that are written, not the ones asked for
+  if (applyConstraints != nullptr && isValidA && isValidB && isValidC)
+  {
+    int requestA = servoA, requestB = servoB, requestC = servoC;
+    applyConstraints(servoA, servoB, servoC, hipServoCentidegrees);
+    alpha = jointA.GetConstrainedAngle(alpha, requestA, servoA);
+    beta = jointB.GetConstrainedAngle(beta, requestB, servoB);
+    gamma = jointC.GetConstrainedAngle(gamma, requestC, servoC);
+  }
+
+  if (isValidC)
+    jointC.RotateToServoCentidegrees(gamma, servoC);
+  if (isValidB)
+    jointB.RotateToServoCentidegrees(beta, servoB);
+  if (isValidA)
+  {
+    jointA.RotateToServoCentidegrees(alpha, servoA);
+    if (number >= 1 && number <= 6)
+      hipServoCentidegrees[number - 1] = servoA;
+  }
 
   Point point;
   CalculatePoint(alpha, beta, gamma, point);
@@ -438,7 +779,7 @@ void Robot::Start()
     case 31:
     case 32:
       productVersion = 3;
-      RobotJoint::firstRotateDelay = 0;
+      RobotJoint::firstRotateDelay = 20;
 
       robotShape.a = 35;
       robotShape.b = 50;
@@ -462,7 +803,7 @@ void Robot::Start()
 
   case 20:
     productVersion = 2;
-    RobotJoint::firstRotateDelay = 0;
+    RobotJoint::firstRotateDelay = 20;
 
     robotShape.a = 32;
     robotShape.b = 50;
@@ -499,6 +840,13 @@ void Robot::Start()
   leg5.Set(robotShape.g, 0, robotShape);
   leg6.Set(robotShape.a, -robotShape.b, robotShape);
 
+  leg1.SetNumber(1);
+  leg2.SetNumber(2);
+  leg3.SetNumber(3);
+  leg4.SetNumber(4);
+  leg5.SetNumber(5);
+  leg6.SetNumber(6);
+
   leg1.jointA.Set(22, -45, true, 90, 200, EepromAddresses::servo22);
   leg1.jointB.Set(23, 0, true, 0, 180, EepromAddresses::servo23);
   leg1.jointC.Set(24, 0, true, 0, 180, EepromAddresses::servo24);
@@ -518,11 +866,19 @@ void Robot::Start()
   leg6.jointB.Set(32, 180, false, 0, 180, EepromAddresses::servo32);
   leg6.jointC.Set(31, 180, false, 0, 180, EepromAddresses::servo31);
 
+  SetCollisionTables();
+
+  // The thermal model integrates from here, not over the time before start-up
+  thermalUpdateTime = millis();
+  // The first control tick reports its period from here too
+  lastUpdateMicros = micros();
+
   MoveToDirectly(bootPoints);
 }
 
 void Robot::InstallState()
 {
+  WakeUp();
   state = State::Install;
   SetOffsetEnableState(false);
   SetSpeed(RobotLeg::defaultStepDistance);
@@ -537,6 +893,7 @@ void Robot::InstallState()
 
 void Robot::CalibrateState()
 {
+  WakeUp();
   state = State::Calibrate;
   SetOffsetEnableState(false);
   SetSpeed(RobotLeg::defaultStepDistance);
@@ -544,7 +901,7 @@ void Robot::CalibrateState()
   WaitUntilFree();
 }
 
-void Robot::SetServoAngle(int leg, int joint, int angle)
+RobotJoint *Robot::GetJoint(int leg, int joint)
 {
   // Get the appropriate leg
   RobotLeg* targetLeg = nullptr;
@@ -555,17 +912,65 @@ void Robot::SetServoAngle(int leg, int joint, int angle)
     case 4: targetLeg = &leg4; break;
     case 5: targetLeg = &leg5; break;
     case 6: targetLeg = &leg6; break;
-    default: return;
+    default: return nullptr;
   }
 
-  // Get the appropriate joint and set angle
+  // Get the appropriate joint
   switch (joint) {
-    case 0: targetLeg->jointA.RotateToServoAngle(angle); break;
-    case 1: targetLeg->jointB.RotateToServoAngle(angle); break;
-    case 2: targetLeg->jointC.RotateToServoAngle(angle); break;
+    case 0: return &targetLeg->jointA;
+    case 1: return &targetLeg->jointB;
+    case 2: return &targetLeg->jointC;
+    default: return nullptr;
   }
 }
 
+bool Robot::SetServoAngle(int leg, int joint, int angle)
+{
+  // Orders call this from the control tick, where WakeUp() could not wait for the servos
+  RobotJoint *targetJoint = GetJoint(leg, joint);
+  if (targetJoint == nullptr || isLowPower)
+    return false;
+  targetJoint->RotateToServoAngle(angle);
+  return true;
+}
+
+bool Robot::SetServoPulseRange(int leg, int joint, unsigned int minPulse, unsigned int maxPulse)
+{
+  RobotJoint *targetJoint = GetJoint(leg, joint);
+  if (targetJoint == nullptr)
+    return false;
+  return targetJoint->SetPulseRange(minPulse, maxPulse);
+}
+
+Robot::OutputCounts Robot::GetOutputCounts()
+{
+  OutputCounts counts;
+  noInterrupts();
+  counts.solves = RobotLeg::solveCount;
+  counts.skippedSolves = RobotLeg::skippedSolveCount;
+  interrupts();
+  counts.servoWrites = ServoDriver::GetWriteCount();
+  counts.skippedServoWrites = ServoDriver::GetSkippedWriteCount();
+  return counts;
+}
+
+void Robot::ResetOutputCounts()
+{
+  noInterrupts();
+  RobotLeg::solveCount = 0;
+  RobotLeg::skippedSolveCount = 0;
+  interrupts();
+  ServoDriver::ResetWriteCounts();
+}
+
+bool Robot::SetServoCurveCorrection(int leg, int joint, byte knot, float correction)
+{
+  RobotJoint *targetJoint = GetJoint(leg, joint);
+  if (targetJoint == nullptr)
+    return false;
+  return targetJoint->SetCurveCorrection(knot, correction);
+}
+
 void Robot::CalibrateServos()
 {
   if (state != State::Calibrate)
@@ -581,6 +986,7 @@ void Robot::CalibrateServos()
 
 void Robot::CalibrateVerify()
 {
+  WakeUp();
   state = State::Calibrate;
   SetSpeed(RobotLeg::defaultStepDistance);
   MoveTo(calibrateStatePoints);
@@ -592,6 +998,7 @@ void Robot::CalibrateVerify()
 
 void Robot::BootState()
 {
+  WakeUp();
   SetOffsetEnableState(true);
   SetSpeed(RobotLeg::defaultStepDistance);
   MoveTo(bootPoints);
@@ -634,7 +1041,16 @@ void Robot::MoveToRelatively(Point point, float speed)
 void Robot::WaitUntilFree()
 {
   while (leg1.isBusy || leg2.isBusy || leg3.isBusy || leg4.isBusy || leg5.isBusy || leg6.isBusy)
-    ;
+  {
+#if defined(DAMSON_HOST_SIM)
+    HostSimWait();
+#endif
+  }
+}
+
+bool Robot::IsBusy()
+{
+  return leg1.isBusy || leg2.isBusy || leg3.isBusy || leg4.isBusy || leg5.isBusy || leg6.isBusy;
 }
 
 void Robot::SetSpeed(float speed)
@@ -665,16 +1081,51 @@ void Robot::SetSpeedMultiple(float multiple)
 
 bool Robot::CheckPoints(RobotLegsPoints points)
 {
-  if (leg1.CheckPoint(points.leg1) &&
-      leg2.CheckPoint(points.leg2) &&
-      leg3.CheckPoint(points.leg3) &&
-      leg4.CheckPoint(points.leg4) &&
-      leg5.CheckPoint(points.leg5) &&
-      leg6.CheckPoint(points.leg6))
-    return true;
+  float alpha[6], beta[6], gamma[6];
+  if (leg1.CheckPoint(points.leg1, alpha[0], beta[0], gamma[0]) &&
+      leg2.CheckPoint(points.leg2, alpha[1], beta[1], gamma[1]) &&
+      leg3.CheckPoint(points.leg3, alpha[2], beta[2], gamma[2]) &&
+      leg4.CheckPoint(points.leg4, alpha[3], beta[3], gamma[3]) &&
+      leg5.CheckPoint(points.leg5, alpha[4], beta[4], gamma[4]) &&
+      leg6.CheckPoint(points.leg6, alpha[5], beta[5], gamma[5]))
+    return CheckCollisions(alpha, beta, gamma);
   return false;
 }
 
+void Robot::SetCollisionTables()
+{
+  RobotLeg *legs[6] = { &leg1, &leg2, &leg3, &leg4, &leg5, &leg6 };
+
+  for (byte pair = 0; pair < LegCollision::pairCount; pair++)
+  {
+    RobotLeg &legA = *legs[LegCollision::pairs[pair][0] - 1];
+    RobotLeg &legB = *legs[LegCollision::pairs[pair][1] - 1];
+    collision.SetPair(pair, legA.GetXOrigin(), legA.GetYOrigin(), legA.jointA.GetMinAngle(), legA.jointA.GetMaxAngle(),
+                      legB.GetXOrigin(), legB.GetYOrigin(), legB.jointA.GetMinAngle(), legB.jointA.GetMaxAngle(),
+                      legA.GetReach());
+  }
+}
+
+bool Robot::CheckCollisions(const float alpha[6], const float beta[6], const float gamma[6])
+{
+  RobotLeg *legs[6] = { &leg1, &leg2, &leg3, &leg4, &leg5, &leg6 };
+
+  for (byte pair = 0; pair < LegCollision::pairCount; pair++)
+  {
+    byte a = LegCollision::pairs[pair][0] - 1;
+    byte b = LegCollision::pairs[pair][1] - 1;
+    if (collision.IsSafe(pair, alpha[a], alpha[b]))
+      continue;
+
+    LegLinks linksA, linksB;
+    legs[a]->CalculateLinks(alpha[a], beta[a], gamma[a], linksA);
+    legs[b]->CalculateLinks(alpha[b], beta[b], gamma[b], linksB);
+    if (!LegCollision::CheckLinks(linksA, linksB))
+      return false;
+  }
+  return true;
+}
+
 void Robot::GetPointsNow(RobotLegsPoints &points)
 {
   points.leg1 = leg1.pointNow;
@@ -687,63 +1138,319 @@ void Robot::GetPointsNow(RobotLegsPoints &points)
 
 void Robot::Update()
 {
+  unsigned long startMicros = micros();
+
   UpdateAction();
   power.Update();
-}
+  energy.AddVoltage(power.voltage);
+  UpdateGovernor();
+  UpdatePowerUp();
+  UpdateThermal();
 
-void Robot::CalibrateLeg(RobotLeg &leg, Point calibratePoint)
-{
-  float alpha, beta, gamma;
-  leg.CalculateAngle(calibratePoint, alpha, beta, gamma);
-  leg.jointA.SetOffset(leg.jointA.jointAngleNow - alpha);
-  leg.jointB.SetOffset(leg.jointB.jointAngleNow - beta);
-  leg.jointC.SetOffset(leg.jointC.jointAngleNow - gamma);
+  loopTiming.periodMicros = startMicros - lastUpdateMicros;
+  lastUpdateMicros = startMicros;
+  loopTiming.updateMicros = micros() - startMicros;
+  loopTiming.maxUpdateMicros = max(loopTiming.maxUpdateMicros, loopTiming.updateMicros);
 }
 
-void Robot::UpdateAction()
+Robot::LoopTiming Robot::GetLoopTiming(bool resetMax)
 {
-  UpdateLegAction(leg1);
-  UpdateLegAction(leg2);
-  UpdateLegAction(leg3);
-  UpdateLegAction(leg4);
-  UpdateLegAction(leg5);
-  UpdateLegAction(leg6);
+  noInterrupts();
+  LoopTiming timing = loopTiming;
+  if (resetMax)
+    loopTiming.maxUpdateMicros = 0;
+  interrupts();
+  return timing;
 }
 
-void Robot::UpdateLegAction(RobotLeg &leg)
+// Groups are assumed to power 6 servo pins each, 22~27, 28~33 and 34~39
+// In each leg the tibia comes first, then the femur and the hip
+const byte Robot::powerUpOrder[powerUpServos][2] = {
+    {1, 2}, {1, 1}, {1, 0}, {2, 2}, {2, 1}, {2, 0},
+    {3, 2}, {3, 1}, {3, 0}, {6, 2}, {6, 1}, {6, 0},
+    {5, 2}, {5, 1}, {5, 0}, {4, 2}, {4, 1}, {4, 0}};
+
+void Robot::UpdatePowerUp()
 {
-  float distanceNow = Point::GetDistance(leg.pointNow, leg.pointGoal);
+  for (byte i = 0; i < powerUpServos; i++)
+    GetJoint(powerUpOrder[i][0], powerUpOrder[i][1])->UpdateRamp();
 
-  // If no active trajectory or goal changed significantly, initialize eased trajectory
-  if (leg.isBusy && (!leg.hasTrajectory || leg.totalDistance < RobotLeg::negligibleDistance))
+  if (powerUpIndex >= powerUpServos)
+    return;
+  if (powerUpCounter > 0)
   {
-    leg.pointStart = leg.pointNow;
-    leg.totalDistance = Point::GetDistance(leg.pointStart, leg.pointGoal);
-    if (leg.totalDistance < RobotLeg::negligibleDistance)
+    powerUpCounter--;
+    return;
+  }
+
+  byte group = powerUpIndex / servosPerPowerGroup + 1;
+  if (group > powerUpGroup)
+  {
+    // Switch on the next group while its servos get no pulse, so they do not start moving together
+    if (power.powerGroupAutoSwitch)
     {
-      // too small: snap to goal and finish
-      leg.MoveToDirectly(leg.pointGoal);
-      leg.isBusy = false;
-      leg.hasTrajectory = false;
-      return;
+      power.SetPowerGroupLimit(group);
+      if (!power.IsPowerGroupOn(group))
+        return;
     }
-    // Duration is proportional to how many fixed steps the old linear model would take
-    float steps = ceil(leg.totalDistance / max(0.001f, (leg.stepDistance * speedMultiple)));
-    if (steps < 1)
-      steps = 1;
-    leg.moveDurationMs = (unsigned long)(steps * 20.0f); // FlexiTimer2 tick is 20ms
-    if (leg.moveDurationMs < 20)
-      leg.moveDurationMs = 20;
-    leg.moveStartMillis = millis();
-    leg.hasTrajectory = true;
+    powerUpGroup = group;
+    powerUpCounter = powerGroupSettleTicks;
+    return;
   }
 
-  if (leg.isBusy && leg.hasTrajectory)
-  {
-    unsigned long now = millis();
-    float t = 0.0f;
-    if (leg.moveDurationMs > 0)
-      t = (float)(now - leg.moveStartMillis) / (float)leg.moveDurationMs;
+  // Hold while the supply is sagging and the group has been switched off
+  if (power.powerGroupAutoSwitch && !power.IsPowerGroupOn(group))
+    return;
+
+  RobotJoint *joint = GetJoint(powerUpOrder[powerUpIndex][0], powerUpOrder[powerUpIndex][1]);
+  joint->Enable();
+  powerUpIndex++;
+  // Every servo gets its own first move before the next one is attached
+  powerUpCounter = max(1, (RobotJoint::firstRotateDelay + 19) / 20) - 1;
+}
+
+float Robot::GetJointHeat(int leg, int joint)
+{
+  if (leg < 1 || leg > 6 || joint < 0 || joint > 2)
+    return 0;
+  return thermal.GetHeat((leg - 1) * 3 + joint);
+}
+
+float Robot::GetSpeedThrottle()
+{
+  return thermal.GetThrottle();
+}
+
+void Robot::UpdateGovernor()
+{
+  unsigned long now = millis();
+  float seconds = (now - governorUpdateTime) / 1000.0;
+  governorUpdateTime = now;
+  governor.Update(power.voltage, power.readingVoltage, seconds);
+}
+
+float Robot::GetSupplySpeed()
+{
+  return governor.GetSpeed();
+}
+
+unsigned int Robot::GetDeratingCount()
+{
+  noInterrupts();
+  unsigned int count = governor.GetEventCount();
+  interrupts();
+  return count;
+}
+
+SupplyGovernor::Event Robot::GetLastDerating()
+{
+  noInterrupts();
+  SupplyGovernor::Event event = governor.GetLastEvent();
+  interrupts();
+  return event;
+}
+
+void Robot::AddGaitStep(float distance, byte stepsPerCycle)
+{
+  noInterrupts();
+  energy.AddStep(distance, stepsPerCycle);
+  interrupts();
+}
+
+EnergyMeter::Report Robot::GetLastGaitCycle()
+{
+  noInterrupts();
+  EnergyMeter::Report report = energy.GetLastCycle();
+  interrupts();
+  return report;
+}
+
+EnergyMeter::Report Robot::GetGaitEnergy()
+{
+  noInterrupts();
+  EnergyMeter::Report report = energy.GetTotal();
+  interrupts();
+  return report;
+}
+
+void Robot::ResetGaitEnergy()
+{
+  noInterrupts();
+  energy.Reset();
+  interrupts();
+}
+
+bool Robot::IsPoweredUp()
+{
+  return powerUpIndex >= powerUpServos;
+}
+
+void Robot::UpdateThermal()
+{
+  RobotLeg *legs[6] = { &leg1, &leg2, &leg3, &leg4, &leg5, &leg6 };
+
+  for (byte i = 0; i < 6; i++)
+  {
+    thermal.AddMotion(i * 3 + 0, legs[i]->jointA.servoAngleNow);
+    thermal.AddMotion(i * 3 + 1, legs[i]->jointB.servoAngleNow);
+    thermal.AddMotion(i * 3 + 2, legs[i]->jointC.servoAngleNow);
+  }
+
+  if (++thermalCounter < thermalUpdateTicks)
+    return;
+  thermalCounter = 0;
+
+  unsigned long now = millis();
+  float seconds = (now - thermalUpdateTime) / 1000.0;
+  thermalUpdateTime = now;
+
+  // The body weight is shared by the lowest feet
+  float lowest = legs[0]->pointNow.z;
+  for (byte i = 1; i < 6; i++)
+    lowest = min(lowest, (float)legs[i]->pointNow.z);
+  byte stanceCount = 0;
+  for (byte i = 0; i < 6; i++)
+    if (legs[i]->pointNow.z < lowest + stanceTolerance)
+      stanceCount++;
+
+  float current = 0;
+  for (byte i = 0; i < 6; i++)
+  {
+    bool isStance = legs[i]->pointNow.z < lowest + stanceTolerance && legs[i]->jointB.IsEnabled();
+    current += UpdateLegThermal(*legs[i], i * 3, isStance ? 1.0 / stanceCount : 0, seconds);
+  }
+  thermal.UpdateThrottle();
+  energy.Update(current, seconds);
+}
+
+float Robot::UpdateLegThermal(RobotLeg &leg, byte firstJoint, float weightShare, float seconds)
+{
+  // The hip turns about a vertical axis and holds no weight
+  // The femur holds the weight over the foot, the tibia over the foot from the knee
+  float femurLoad = 0, tibiaLoad = 0;
+  if (weightShare > 0)
+  {
+    float beta = leg.jointB.jointAngleNow * PI / 180;
+    float gamma = leg.jointC.jointAngleNow * PI / 180;
+    float tibiaLever = robotShape.f * sin(gamma - beta);
+    femurLoad = weightShare * fabs(robotShape.e * sin(beta) + tibiaLever);
+    tibiaLoad = weightShare * fabs(tibiaLever);
+  }
+
+  // The estimated current of the enabled servos, from the same motion and load
+  float current = 0;
+  if (leg.jointA.IsEnabled())
+    current += EnergyMeter::GetServoCurrent(thermal.GetMotion(firstJoint + 0), 0, seconds);
+  if (leg.jointB.IsEnabled())
+    current += EnergyMeter::GetServoCurrent(thermal.GetMotion(firstJoint + 1), femurLoad, seconds);
+  if (leg.jointC.IsEnabled())
+    current += EnergyMeter::GetServoCurrent(thermal.GetMotion(firstJoint + 2), tibiaLoad, seconds);
+
+  thermal.Update(firstJoint + 0, 0, seconds);
+  thermal.Update(firstJoint + 1, femurLoad, seconds);
+  thermal.Update(firstJoint + 2, tibiaLoad, seconds);
+  return current;
+}
+
+void Robot::LowPowerState()
+{
+  if (isLowPower)
+    return;
+  WaitUntilFree();
+
+  // Also stops a start-up sequence that is still running
+  noInterrupts();
+  powerUpIndex = powerUpServos;
+  isLowPower = true;
+  interrupts();
+
+  for (byte i = 0; i < powerUpServos; i++)
+    GetJoint(powerUpOrder[i][0], powerUpOrder[i][1])->Disable();
+
+  if (power.powerGroupAutoSwitch)
+    power.SetPowerGroupLimit(0);
+}
+
+void Robot::WakeUp()
+{
+  if (!isLowPower)
+    return;
+
+  noInterrupts();
+  powerUpIndex = 0;
+  powerUpGroup = 0;
+  powerUpCounter = 0;
+  isLowPower = false;
+  interrupts();
+
+  unsigned long startTime = millis();
+  while (!IsPoweredUp() && millis() - startTime < wakeTimeout)
+  {
+#if defined(DAMSON_HOST_SIM)
+    HostSimWait();
+#endif
+  }
+}
+
+void Robot::CalibrateLeg(RobotLeg &leg, Point calibratePoint)
+{
+  float alpha, beta, gamma;
+  leg.CalculateAngle(calibratePoint, alpha, beta, gamma);
+  leg.jointA.SetOffset(leg.jointA.jointAngleNow - alpha);
+  leg.jointB.SetOffset(leg.jointB.jointAngleNow - beta);
+  leg.jointC.SetOffset(leg.jointC.jointAngleNow - gamma);
+}
+
+void Robot::UpdateAction()
+{
+  UpdateLegAction(leg1);
+  UpdateLegAction(leg2);
+  UpdateLegAction(leg3);
+  UpdateLegAction(leg4);
+  UpdateLegAction(leg5);
+  UpdateLegAction(leg6);
+}
+
+void Robot::UpdateLegAction(RobotLeg &leg)
+{
+  float distanceNow = Point::GetDistance(leg.pointNow, leg.pointGoal);
+
+  // If no active trajectory or goal changed significantly, initialize eased trajectory
+  if (leg.isBusy && (!leg.hasTrajectory || leg.totalDistance < RobotLeg::negligibleDistance))
+  {
+    leg.pointStart = leg.pointNow;
+    leg.totalDistance = Point::GetDistance(leg.pointStart, leg.pointGoal);
+    if (leg.totalDistance < RobotLeg::negligibleDistance)
+    {
+      // too small: snap to goal and finish
+      leg.MoveToDirectly(leg.pointGoal);
+      leg.isBusy = false;
+      leg.hasTrajectory = false;
+      return;
+    }
+    // Duration is proportional to how many fixed steps the old linear model would take
+    // Hot joints slow every new move down, see JointThermal
+    float steps = ceil(leg.totalDistance / max(0.001f, (leg.stepDistance * speedMultiple * thermal.GetThrottle())));
+    if (steps < 1)
+      steps = 1;
+    leg.moveDurationMs = (unsigned long)(steps * 20.0f); // FlexiTimer2 tick is 20ms
+    if (leg.moveDurationMs < 20)
+      leg.moveDurationMs = 20;
+    leg.moveUpdateMillis = millis();
+    leg.moveElapsedMs = 0;
+    leg.hasTrajectory = true;
+  }
+
+  if (leg.isBusy && leg.hasTrajectory)
+  {
+    // Time runs slower while the supply is derated, which scales the speed by the factor and the
+    // acceleration by its square along the same path
+    unsigned long now = millis();
+    leg.moveElapsedMs += (float)(now - leg.moveUpdateMillis) * governor.GetSpeed();
+    leg.moveUpdateMillis = now;
+    float t = 0.0f;
+    if (leg.moveDurationMs > 0)
+      t = leg.moveElapsedMs / (float)leg.moveDurationMs;
     if (t < 0)
       t = 0;
     if (t > 1)
@@ -774,6 +1481,13 @@ void Robot::UpdateLegAction(RobotLeg &leg)
 
 void Robot::MoveToDirectly(RobotLegsPoints points)
 {
+  leg1.pointGoal = points.leg1;
+  leg2.pointGoal = points.leg2;
+  leg3.pointGoal = points.leg3;
+  leg4.pointGoal = points.leg4;
+  leg5.pointGoal = points.leg5;
+  leg6.pointGoal = points.leg6;
+
   leg1.MoveToDirectly(points.leg1);
   leg2.MoveToDirectly(points.leg2);
   leg3.MoveToDirectly(points.leg3);
@@ -820,6 +1534,15 @@ void RobotAction::SetActionGroup(int group)
   default:
     crawlSteps = 2;
   }
+
+  SetGaitParams(GaitParamSets::getGroup(group));
+}
+
+void RobotAction::SetGaitParams(GaitParams params)
+{
+  crawlLength = params.crawlLength;
+  legLift = params.legLift;
+  legLiftSpeed = params.legLiftSpeed;
 }
 
 void RobotAction::ActiveMode()
@@ -836,18 +1559,52 @@ void RobotAction::ActiveMode()
   mode = Mode::Active;
 }
 
-void RobotAction::SleepMode()
+bool RobotAction::SleepMode()
 {
+  if (robot.IsLowPower())
+    return true;
+
   ActionState();
   if (legsState != LegsState::CrawlState)
     InitialState();
-  if (mode == Mode::Sleep)
-    return;
+  // A held pose would keep part of the body up
+  ClearBodyPose();
+  if (mode != Mode::Sleep)
+  {
+    LegsMoveToRelatively(Point(0, 0, bodyLift), bodyLiftSpeed);
 
-  LegsMoveToRelatively(Point(0, 0, bodyLift), bodyLiftSpeed);
+    legsState = LegsState::CrawlState;
+    mode = Mode::Sleep;
+  }
 
-  legsState = LegsState::CrawlState;
-  mode = Mode::Sleep;
+  // The lowering can be scaled down or refused, then the servos still hold the body
+  if (!IsBodyDown())
+  {
+    RobotLegsPoints points;
+    GetGaitPointsNow(points);
+    points.leg1.z = points.leg2.z = points.leg3.z = -bodyLift;
+    points.leg4.z = points.leg5.z = points.leg6.z = -bodyLift;
+    LegsMoveTo(points, bodyLiftSpeed);
+    mode = Mode::Active;
+    return false;
+  }
+
+  // The body rests on the ground, the servos need not hold it
+  robot.LowPowerState();
+  return true;
+}
+
+bool RobotAction::IsBodyDown()
+{
+  RobotLegsPoints points;
+  robot.GetPointsNow(points);
+  Point *feet[6] = { &points.leg1, &points.leg2, &points.leg3, &points.leg4, &points.leg5, &points.leg6 };
+  for (byte i = 0; i < 6; i++)
+  {
+    if (fabs(feet[i]->z) > bodyDownTolerance)
+      return false;
+  }
+  return true;
 }
 
 void RobotAction::SwitchMode()
@@ -911,15 +1668,12 @@ void RobotAction::InitialState()
   if (legsState == LegsState::CrawlState)
   {
     ActiveMode();
-  }
-  else if (legsState == LegsState::TwistBodyState)
-  {
-    TwistBody(Point(0, 0, bodyLift - defaultBodyLift), Point(0, 0, 0), 0);
+    ClearBodyPose();
   }
   else if (legsState == LegsState::LegMoveState)
   {
     RobotLegsPoints points;
-    robot.GetPointsNow(points);
+    GetGaitPointsNow(points);
 
     points.leg1.z = -bodyLift;
     points.leg2.z = -bodyLift;
@@ -930,7 +1684,6 @@ void RobotAction::InitialState()
 
     LegsMoveTo(points, bodyLiftSpeed);
   }
-  robot.GetPointsNow(lastChangeLegsStatePoints);
   mode = Mode::Active;
   legsState = LegsState::CrawlState;
 }
@@ -995,13 +1748,14 @@ void RobotAction::LegMoveToRelativelyDirectly(int leg, Point point)
 
 void RobotAction::ActionState()
 {
+  robot.WakeUp();
   if (robot.state != Robot::State::Action)
   {
     robot.BootState();
     robot.state = Robot::State::Action;
     mode = Mode::Sleep;
     legsState = LegsState::CrawlState;
-    lastChangeLegsStatePoints = initialPoints;
+    bodyPose = BodyPose();
   }
 }
 
@@ -1021,237 +1775,299 @@ void RobotAction::Crawl(float x, float y, float angle)
   }
   angle = constrain(angle, -turnAngle, turnAngle);
 
-  x /= crawlSteps;
-  y /= crawlSteps;
+  if (angle == 0)
+  {
+    CrawlStep(Point(x, y, 0), Point(0, 0, 0), 0);
+    return;
+  }
+
+  // Walk the same displacement as one arc around the instantaneous centre of rotation
+  Point centre = GetArcCentre(x, y, angle);
+  angle = GetArcLimitAngle(centre, angle);
+  CrawlStep(Point(0, 0, 0), centre, angle);
+}
+
+void RobotAction::CrawlArc(float xCentre, float yCentre, float angle)
+{
+  ActionState();
+  if (legsState != LegsState::CrawlState)
+    InitialState();
+  if (mode != Mode::Active)
+    ActiveMode();
+
+  angle = constrain(angle, -turnAngle, turnAngle);
+
+  Point centre(xCentre, yCentre, 0);
+  angle = GetArcLimitAngle(centre, angle);
+  CrawlStep(Point(0, 0, 0), centre, angle);
+}
+
+bool RobotAction::CrawlPath(const PathPose poses[], int count)
+{
+  ActionState();
+  if (legsState != LegsState::CrawlState)
+    InitialState();
+  if (mode != Mode::Active)
+    ActiveMode();
+
+  FootstepPlan plan;
+  if (!GetPathPlan(plan, poses, count))
+    return false;
+
+  // Plan every foothold before lifting a leg, shorter steps where one can not be reached
+  int refines = 0;
+  int failedStep;
+  while ((failedStep = CheckPathPlan(plan)) >= 0)
+  {
+    if (++refines > maxPathRefines)
+      return false;
+    plan.RefineSegment(plan.GetSegment(failedStep));
+  }
+
+  int steps = plan.GetStepCount();
+  for (int step = 0; step < steps; step++)
+  {
+    Point move, centre;
+    float angle;
+    plan.GetStep(step, move, centre, angle);
+
+    RobotLegsPoints points4, points5;
+    GetPathSwingPoints(plan, step, points4, points5);
+    CrawlLegsStep(move, centre, angle, points4, points5);
+  }
+  return true;
+}
+
+bool RobotAction::GetPathPlan(FootstepPlan &plan, const PathPose poses[], int count)
+{
+  float x = 0, y = 0, angle = 0;
+  for (int i = 0; i < count; i++)
+  {
+    // Each segment is walked relative to the body at the previous pose
+    float radian = -angle * PI / 180;
+    float dx = poses[i].x - x;
+    float dy = poses[i].y - y;
+    Point move(dx * cos(radian) - dy * sin(radian), dx * sin(radian) + dy * cos(radian), 0);
+    float turn = poses[i].angle - angle;
+
+    Point centre(0, 0, 0);
+    float loops = sqrt(pow(move.x, 2) + pow(move.y, 2)) / crawlLength;
+    if (turn != 0)
+    {
+      centre = GetArcCentre(move.x, move.y, turn);
+      loops = abs(turn) / abs(GetArcLimitAngle(centre, constrain(turn, -turnAngle, turnAngle)));
+    }
+
+    x = poses[i].x;
+    y = poses[i].y;
+    angle = poses[i].angle;
+
+    if (loops == 0)
+      continue;
+    if (!plan.AddSegment(move, centre, turn, (int)ceil(loops) * crawlSteps))
+      return false;
+  }
+  return true;
+}
+
+int RobotAction::CheckPathPlan(FootstepPlan &plan)
+{
+  RobotLegsPoints points;
+  GetGaitPointsNow(points);
+  int index = legMoveIndex;
+
+  int steps = plan.GetStepCount();
+  for (int step = 0; step < steps; step++)
+  {
+    Point move, centre;
+    float angle;
+    plan.GetStep(step, move, centre, angle);
+
+    RobotLegsPoints points4, points5;
+    GetPathSwingPoints(plan, step, points4, points5);
+
+    index < crawlSteps ? index++ : index = 1;
+    byte swingLegs = GetSwingLegs(index);
+
+    RobotLegsPoints points2 = points;
+    GetArcPoints(points2, move, centre, angle, -0.5);
+    SetSwingLegsPoints(points2, points4, swingLegs);
+    GetArcPoints(points, move, centre, angle, -1);
+    SetSwingLegsPoints(points, points5, swingLegs);
+
+    if (!CheckPosedPoints(points2) || !CheckPosedPoints(points) ||
+        !CheckCrawlPoints(points2) || !CheckCrawlPoints(points))
+      return step;
+  }
+  return -1;
+}
+
+void RobotAction::GetPathSwingPoints(FootstepPlan &plan, int step, RobotLegsPoints &points4, RobotLegsPoints &points5)
+{
+  // Land where the foot passes under its boot point halfway through its next stance, using the
+  // steps that follow instead of repeating this one
+  float lookAhead = (crawlSteps - 1) / 2.0;
+
+  points4 = robot.bootPoints;
+  GetCrawlPoints(points4, Point(0, 0, -bodyLift + legLift));
+  GetPathLandingPoints(plan, step, points4, lookAhead / 2);
+
+  points5 = robot.bootPoints;
+  GetCrawlPoints(points5, Point(0, 0, -bodyLift));
+  GetPathLandingPoints(plan, step, points5, lookAhead);
+}
+
+void RobotAction::GetPathLandingPoints(FootstepPlan &plan, int step, RobotLegsPoints &points, float lookAhead)
+{
+  Point move, centre;
+  float angle;
+
+  // Apply the motions of the coming steps, the farthest one first
+  int whole = (int)lookAhead;
+  float fraction = lookAhead - whole;
+  if (fraction > 0)
+  {
+    plan.GetStep(step + whole + 1, move, centre, angle);
+    GetArcPoints(points, move, centre, angle, fraction);
+  }
+  for (int i = whole; i >= 1; i--)
+  {
+    plan.GetStep(step + i, move, centre, angle);
+    GetArcPoints(points, move, centre, angle, 1);
+  }
+}
+
+void RobotAction::CrawlStep(Point move, Point centre, float angle)
+{
+  move.x /= crawlSteps;
+  move.y /= crawlSteps;
   angle /= crawlSteps;
 
+  RobotLegsPoints points4 = robot.bootPoints;
+  GetCrawlPoints(points4, Point(0, 0, -bodyLift + legLift));
+  GetArcPoints(points4, move, centre, angle, (crawlSteps - 1) / 2.0 / 2);
+
+  RobotLegsPoints points5 = robot.bootPoints;
+  GetCrawlPoints(points5, Point(0, 0, -bodyLift));
+  GetArcPoints(points5, move, centre, angle, (crawlSteps - 1) / 2.0);
+
+  CrawlLegsStep(move, centre, angle, points4, points5);
+}
+
+void RobotAction::CrawlLegsStep(Point move, Point centre, float angle, RobotLegsPoints points4, RobotLegsPoints points5)
+{
+  // move, centre and angle are the body motion of this step, points4 and points5 are where
+  // the swinging legs are lifted to and land
   RobotLegsPoints points1;
-  robot.GetPointsNow(points1);
+  GetGaitPointsNow(points1);
 
   RobotLegsPoints points2 = points1;
-  GetCrawlPoints(points2, Point(-x / 2, -y / 2, 0));
-  GetTurnPoints(points2, -angle / 2);
+  GetArcPoints(points2, move, centre, angle, -0.5);
 
   RobotLegsPoints points3 = points1;
-  GetCrawlPoints(points3, Point(-x, -y, 0));
-  GetTurnPoints(points3, -angle);
+  GetArcPoints(points3, move, centre, angle, -1);
 
-  RobotLegsPoints points4 = robot.bootPoints;
-  GetCrawlPoints(points4, Point(x * (crawlSteps - 1) / 2 / 2, y * (crawlSteps - 1) / 2 / 2, -bodyLift + legLift));
-  GetTurnPoints(points4, angle * (crawlSteps - 1) / 2 / 2);
+  legMoveIndex < crawlSteps ? legMoveIndex++ : legMoveIndex = 1;
+  byte swingLegs = GetSwingLegs(legMoveIndex);
 
-  RobotLegsPoints points5 = robot.bootPoints;
-  GetCrawlPoints(points5, Point(x * (crawlSteps - 1) / 2, y * (crawlSteps - 1) / 2, -bodyLift));
-  GetTurnPoints(points5, angle * (crawlSteps - 1) / 2);
+  SetSwingLegsPoints(points2, points4, swingLegs);
+  SetSwingLegsPoints(points3, points5, swingLegs);
 
-  legMoveIndex < crawlSteps ? legMoveIndex++ : legMoveIndex = 1;
+  // A step that can not all be reached is shortened, it is only dropped if none of it can be
+  float fraction = ProjectStep(points1, points2, points3);
+  if (fraction > 0)
+  {
+    AddBodySway(points2, points3, swingLegs);
+
+    // The speeds of the legs are set relative to the first swing leg
+    int leadLeg = 1;
+    while (!(swingLegs & (1 << (leadLeg - 1))))
+      leadLeg++;
+
+    LegsMoveTo(points2, leadLeg, legLiftSpeed);
+    LegsMoveTo(points3, leadLeg, legLiftSpeed);
+
+    // Body travel of the part of the step that was moved, along the arc when turning
+    float distance = sqrt(pow(move.x, 2) + pow(move.y, 2)) + fabs(angle) * PI / 180 * sqrt(pow(centre.x, 2) + pow(centre.y, 2));
+    robot.AddGaitStep(distance * fraction, crawlSteps);
+  }
+
+  legsState = LegsState::CrawlState;
+}
+
+byte RobotAction::GetSwingLegs(int index)
+{
+  // Legs lifted in each step of the loop, bit 0 = leg 1, matching the crawl sequences
+  static const byte swingLegs2[2] = { 0b010101, 0b101010 };
+  static const byte swingLegs4[4] = { 0b100001, 0b010000, 0b001100, 0b000010 };
+  static const byte swingLegs6[6] = { 0b000001, 0b010000, 0b000100, 0b001000, 0b000010, 0b100000 };
 
   switch (crawlSteps)
   {
-  case 2:
-    switch (legMoveIndex)
-    {
-    case 1:
-      points2.leg1 = points4.leg1;
-      points3.leg1 = points5.leg1;
-      points2.leg3 = points4.leg3;
-      points3.leg3 = points5.leg3;
-      points2.leg5 = points4.leg5;
-      points3.leg5 = points5.leg5;
-      if (CheckCrawlPoints(points2))
-      {
-        if (!CheckCrawlPoints(points3))
-        {
-          points3 = points2;
-          points3.leg1.z = points1.leg1.z;
-          points3.leg3.z = points1.leg3.z;
-          points3.leg5.z = points1.leg5.z;
-        }
-        LegsMoveTo(points2, 1, legLiftSpeed);
-        LegsMoveTo(points3, 1, legLiftSpeed);
-      }
-      break;
-    case 2:
-      points2.leg2 = points4.leg2;
-      points3.leg2 = points5.leg2;
-      points2.leg4 = points4.leg4;
-      points3.leg4 = points5.leg4;
-      points2.leg6 = points4.leg6;
-      points3.leg6 = points5.leg6;
-      if (CheckCrawlPoints(points2))
-      {
-        if (!CheckCrawlPoints(points3))
-        {
-          points3 = points2;
-          points3.leg2.z = points1.leg2.z;
-          points3.leg4.z = points1.leg4.z;
-          points3.leg6.z = points1.leg6.z;
-        }
-        LegsMoveTo(points2, 2, legLiftSpeed);
-        LegsMoveTo(points3, 2, legLiftSpeed);
-      }
-      break;
-    }
-    break;
   case 4:
-    switch (legMoveIndex)
-    {
-    case 1:
-      points2.leg1 = points4.leg1;
-      points3.leg1 = points5.leg1;
-      points2.leg6 = points4.leg6;
-      points3.leg6 = points5.leg6;
-      if (CheckCrawlPoints(points2))
-      {
-        if (!CheckCrawlPoints(points3))
-        {
-          points3 = points2;
-          points3.leg1.z = points1.leg1.z;
-          points3.leg6.z = points1.leg6.z;
-        }
-        LegsMoveTo(points2, 1, legLiftSpeed);
-        LegsMoveTo(points3, 1, legLiftSpeed);
-      }
-      break;
-    case 2:
-      points2.leg5 = points4.leg5;
-      points3.leg5 = points5.leg5;
-      if (CheckCrawlPoints(points2))
-      {
-        if (!CheckCrawlPoints(points3))
-        {
-          points3 = points2;
-          points3.leg5.z = points1.leg5.z;
-        }
-        LegsMoveTo(points2, 5, legLiftSpeed);
-        LegsMoveTo(points3, 5, legLiftSpeed);
-      }
-      break;
-    case 3:
-      points2.leg3 = points4.leg3;
-      points3.leg3 = points5.leg3;
-      points2.leg4 = points4.leg4;
-      points3.leg4 = points5.leg4;
-      if (CheckCrawlPoints(points2))
-      {
-        if (!CheckCrawlPoints(points3))
-        {
-          points3 = points2;
-          points3.leg3.z = points1.leg3.z;
-          points3.leg4.z = points1.leg4.z;
-        }
-        LegsMoveTo(points2, 3, legLiftSpeed);
-        LegsMoveTo(points3, 3, legLiftSpeed);
-      }
-      break;
-    case 4:
-      points2.leg2 = points4.leg2;
-      points3.leg2 = points5.leg2;
-      if (CheckCrawlPoints(points2))
-      {
-        if (!CheckCrawlPoints(points3))
-        {
-          points3 = points2;
-          points3.leg2.z = points1.leg2.z;
-        }
-        LegsMoveTo(points2, 2, legLiftSpeed);
-        LegsMoveTo(points3, 2, legLiftSpeed);
-      }
-      break;
-    }
-    break;
+    return swingLegs4[index - 1];
   case 6:
-    switch (legMoveIndex)
-    {
-    case 1:
-      points2.leg1 = points4.leg1;
-      points3.leg1 = points5.leg1;
-      if (CheckCrawlPoints(points2))
-      {
-        if (!CheckCrawlPoints(points3))
-        {
-          points3 = points2;
-          points3.leg1.z = points1.leg1.z;
-        }
-        LegsMoveTo(points2, 1, legLiftSpeed);
-        LegsMoveTo(points3, 1, legLiftSpeed);
-      }
-      break;
-    case 2:
-      points2.leg5 = points4.leg5;
-      points3.leg5 = points5.leg5;
-      if (CheckCrawlPoints(points2))
-      {
-        if (!CheckCrawlPoints(points3))
-        {
-          points3 = points2;
-          points3.leg5.z = points1.leg5.z;
-        }
-        LegsMoveTo(points2, 5, legLiftSpeed);
-        LegsMoveTo(points3, 5, legLiftSpeed);
-      }
-      break;
-    case 3:
-      points2.leg3 = points4.leg3;
-      points3.leg3 = points5.leg3;
-      if (CheckCrawlPoints(points2))
-      {
-        if (!CheckCrawlPoints(points3))
-        {
-          points3 = points2;
-          points3.leg3.z = points1.leg3.z;
-        }
-        LegsMoveTo(points2, 3, legLiftSpeed);
-        LegsMoveTo(points3, 3, legLiftSpeed);
-      }
-      break;
-    case 4:
-      points2.leg4 = points4.leg4;
-      points3.leg4 = points5.leg4;
-      if (CheckCrawlPoints(points2))
-      {
-        if (!CheckCrawlPoints(points3))
-        {
-          points3 = points2;
-          points3.leg4.z = points1.leg4.z;
-        }
-        LegsMoveTo(points2, 4, legLiftSpeed);
-        LegsMoveTo(points3, 4, legLiftSpeed);
-      }
-      break;
-    case 5:
-      points2.leg2 = points4.leg2;
-      points3.leg2 = points5.leg2;
-      if (CheckCrawlPoints(points2))
-      {
-        if (!CheckCrawlPoints(points3))
-        {
-          points3 = points2;
-          points3.leg2.z = points1.leg2.z;
-        }
-        LegsMoveTo(points2, 2, legLiftSpeed);
-        LegsMoveTo(points3, 2, legLiftSpeed);
-      }
-      break;
-    case 6:
-      points2.leg6 = points4.leg6;
-      points3.leg6 = points5.leg6;
-      if (CheckCrawlPoints(points2))
-      {
-        if (!CheckCrawlPoints(points3))
-        {
-          points3 = points2;
-          points3.leg6.z = points1.leg6.z;
-        }
-        LegsMoveTo(points2, 6, legLiftSpeed);
-        LegsMoveTo(points3, 6, legLiftSpeed);
-      }
-      break;
-    }
-    break;
+    return swingLegs6[index - 1];
+  default:
+    return swingLegs2[index - 1];
   }
+}
 
-  legsState = LegsState::CrawlState;
+void RobotAction::SetSwingLegsPoints(RobotLegsPoints &points, RobotLegsPoints swingPoints, byte swingLegs)
+{
+  if (swingLegs & 0b000001)
+    points.leg1 = swingPoints.leg1;
+  if (swingLegs & 0b000010)
+    points.leg2 = swingPoints.leg2;
+  if (swingLegs & 0b000100)
+    points.leg3 = swingPoints.leg3;
+  if (swingLegs & 0b001000)
+    points.leg4 = swingPoints.leg4;
+  if (swingLegs & 0b010000)
+    points.leg5 = swingPoints.leg5;
+  if (swingLegs & 0b100000)
+    points.leg6 = swingPoints.leg6;
+}
+
+void RobotAction::AddBodySway(RobotLegsPoints &points2, RobotLegsPoints &points3, byte swingLegs)
+{
+  Point sway = SupportPolygon::GetSwayOffset(points2, points3, ~swingLegs & 0b111111, stabilityMargin, maxBodySway);
+  if (sway.x == 0 && sway.y == 0)
+    return;
+
+  // The stance feet are shifted while the swing legs rise, the swing legs keep their points
+  Point feet(-sway.x, -sway.y, 0);
+  RobotLegsPoints points2Sway = points2;
+  RobotLegsPoints points3Sway = points3;
+  GetCrawlPoints(points2Sway, feet);
+  GetCrawlPoints(points3Sway, feet);
+  SetSwingLegsPoints(points2Sway, points2, swingLegs);
+  SetSwingLegsPoints(points3Sway, points3, swingLegs);
+  if (!CheckStepPoints(points2Sway, points3Sway))
+    return;
+
+  points2 = points2Sway;
+  points3 = points3Sway;
+}
+
+void RobotAction::ShiftBodyForSwing(int leg)
+{
+  if (leg < 1 || leg > 6)
+    return;
+
+  ActionState();
+  if (legsState != LegsState::LegMoveState)
+    InitialState();
+
+  // A single leg is lifted by the moves that follow, so the body is shifted on its own first
+  RobotLegsPoints points;
+  GetGaitPointsNow(points);
+  Point sway = SupportPolygon::GetSwayOffset(points, points, ~(1 << (leg - 1)) & 0b111111, stabilityMargin, maxBodySway);
+  GetCrawlPoints(points, Point(-sway.x, -sway.y, 0));
+  if ((sway.x != 0 || sway.y != 0) && CheckPosedPoints(points))
+    LegsMoveTo(points, legLiftSpeed);
+
+  legsState = LegsState::LegMoveState;
 }
 
 void RobotAction::ChangeBodyHeight(float height)
@@ -1266,7 +2082,7 @@ void RobotAction::ChangeBodyHeight(float height)
   bodyLift = defaultBodyLift + height;
 
   RobotLegsPoints points;
-  robot.GetPointsNow(points);
+  GetGaitPointsNow(points);
 
   points.leg1.z = -bodyLift;
   points.leg2.z = -bodyLift;
@@ -1339,16 +2155,6 @@ void RobotAction::GetCrawlPoint(Point &point, Point direction)
   point = Point(point.x + direction.x, point.y + direction.y, point.z + direction.z);
 }
 
-void RobotAction::GetTurnPoints(RobotLegsPoints &points, float angle)
-{
-  GetTurnPoint(points.leg1, angle);
-  GetTurnPoint(points.leg2, angle);
-  GetTurnPoint(points.leg3, angle);
-  GetTurnPoint(points.leg4, angle);
-  GetTurnPoint(points.leg5, angle);
-  GetTurnPoint(points.leg6, angle);
-}
-
 void RobotAction::GetTurnPoint(Point &point, float angle)
 {
   float radian = angle * PI / 180;
@@ -1360,90 +2166,311 @@ void RobotAction::GetTurnPoint(Point &point, float angle)
   point = Point(x, y, point.z);
 }
 
+Point RobotAction::GetArcCentre(float x, float y, float angle)
+{
+  // Solve (I - R(angle)) * centre = (x, y), the point that a rotation by angle
+  // moves the body origin around to end at the displacement (x, y)
+  float cot = 1 / tan(angle * PI / 180 / 2);
+
+  return Point((x - y * cot) / 2, (x * cot + y) / 2, 0);
+}
+
+float RobotAction::GetArcLimitAngle(Point centre, float angle)
+{
+  // Limit the chord of the foot farthest from the centre to maxArcChord, not to crawlLength,
+  // so tuning the stride does not change how fast the robot turns
+  float radius = 0;
+  radius = max(radius, (float)Point::GetDistance(Point(robot.bootPoints.leg1.x, robot.bootPoints.leg1.y, 0), centre));
+  radius = max(radius, (float)Point::GetDistance(Point(robot.bootPoints.leg2.x, robot.bootPoints.leg2.y, 0), centre));
+  radius = max(radius, (float)Point::GetDistance(Point(robot.bootPoints.leg3.x, robot.bootPoints.leg3.y, 0), centre));
+  radius = max(radius, (float)Point::GetDistance(Point(robot.bootPoints.leg4.x, robot.bootPoints.leg4.y, 0), centre));
+  radius = max(radius, (float)Point::GetDistance(Point(robot.bootPoints.leg5.x, robot.bootPoints.leg5.y, 0), centre));
+  radius = max(radius, (float)Point::GetDistance(Point(robot.bootPoints.leg6.x, robot.bootPoints.leg6.y, 0), centre));
+
+  if (radius * 2 <= maxArcChord)
+    return angle;
+
+  float maxAngle = 2 * asin(maxArcChord / (radius * 2)) * 180 / PI;
+  return constrain(angle, -maxAngle, maxAngle);
+}
+
+void RobotAction::GetArcPoints(RobotLegsPoints &points, Point move, Point centre, float angle, float fraction)
+{
+  if (angle == 0)
+  {
+    GetCrawlPoints(points, Point(move.x * fraction, move.y * fraction, 0));
+    return;
+  }
+
+  GetArcPoint(points.leg1, centre, angle * fraction);
+  GetArcPoint(points.leg2, centre, angle * fraction);
+  GetArcPoint(points.leg3, centre, angle * fraction);
+  GetArcPoint(points.leg4, centre, angle * fraction);
+  GetArcPoint(points.leg5, centre, angle * fraction);
+  GetArcPoint(points.leg6, centre, angle * fraction);
+}
+
+void RobotAction::GetArcPoint(Point &point, Point centre, float angle)
+{
+  GetCrawlPoint(point, Point(-centre.x, -centre.y, 0));
+  GetTurnPoint(point, angle);
+  GetCrawlPoint(point, Point(centre.x, centre.y, 0));
+}
+
 void RobotAction::TwistBody(Point move, Point rotateAxis, float rotateAngle)
+{
+  rotateAngle = constrain(rotateAngle, -maxBodyRotate, maxBodyRotate);
+  TwistBody(BodyPose(move.x, move.y, move.z, Quaternion::FromAxisAngle(rotateAxis.x, rotateAxis.y, rotateAxis.z, rotateAngle)));
+}
+
+void RobotAction::TwistBody(BodyPose pose)
 {
   ActionState();
-  if (legsState != LegsState::TwistBodyState)
+  if (legsState != LegsState::CrawlState)
     InitialState();
+  if (mode != Mode::Active)
+    ActiveMode();
 
-  RobotLegsPoints points = lastChangeLegsStatePoints;
-  points.leg1.z = -defaultBodyLift;
-  points.leg2.z = -defaultBodyLift;
-  points.leg3.z = -defaultBodyLift;
-  points.leg4.z = -defaultBodyLift;
-  points.leg5.z = -defaultBodyLift;
-  points.leg6.z = -defaultBodyLift;
+  // The pose is kept while crawling, the feet stay where the gait put them
+  RobotLegsPoints points;
+  GetGaitPointsNow(points);
 
-  // move body
-  move.x = constrain(move.x, -30, 30);
-  move.y = constrain(move.y, -30, 30);
-  move.z = constrain(move.z, 0, 45);
-  GetMoveBodyPoints(points, move);
+  BodyPose lastPose = bodyPose;
+  pose = ConstrainBodyPose(pose);
+  bodyPose = pose;
 
-  // rotate body
-  rotateAngle = constrain(rotateAngle, -15, 15);
-  GetRotateBodyPoints(points, rotateAxis, rotateAngle);
+  if (!CheckPosedPoints(points))
+  {
+    // Go as far toward the pose as every leg reaches, moving and rotating the body together
+    float reached = 0;
+    float unreached = 1;
+    for (byte i = 0; i < projectionSteps; i++)
+    {
+      float fraction = (reached + unreached) / 2;
+      bodyPose = BodyPose::Slerp(lastPose, pose, fraction);
+      if (CheckPosedPoints(points))
+        reached = fraction;
+      else
+        unreached = fraction;
+    }
+    if (reached == 0)
+    {
+      bodyPose = lastPose;
+      return;
+    }
+    bodyPose = BodyPose::Slerp(lastPose, pose, reached);
+  }
 
   LegsMoveTo(points, speedTwistBody);
+}
 
-  legsState = LegsState::TwistBodyState;
+BodyPose RobotAction::ConstrainBodyPose(BodyPose pose)
+{
+  // z is relative to the crawl height, the body stays 0 ~ maxBodyHeight above the default height
+  float height = bodyLift - defaultBodyLift;
+  pose.SetMove(
+      constrain(pose.GetMoveX(), -maxBodyMove, maxBodyMove),
+      constrain(pose.GetMoveY(), -maxBodyMove, maxBodyMove),
+      constrain(pose.GetMoveZ(), -height, maxBodyHeight - height));
+
+  float rotateAngle = pose.GetRotation().GetAngle();
+  if (rotateAngle > maxBodyRotate)
+    pose.SetRotation(Quaternion::Slerp(Quaternion(), pose.GetRotation(), maxBodyRotate / rotateAngle));
+  return pose;
 }
 
-void RobotAction::GetMoveBodyPoints(RobotLegsPoints &points, Point point)
+void RobotAction::StreamBodyPose(BodyPose pose)
 {
-  GetMoveBodyPoint(points.leg1, point);
-  GetMoveBodyPoint(points.leg2, point);
-  GetMoveBodyPoint(points.leg3, point);
-  GetMoveBodyPoint(points.leg4, point);
-  GetMoveBodyPoint(points.leg5, point);
-  GetMoveBodyPoint(points.leg6, point);
+  streamPose = ConstrainBodyPose(pose);
+  streamPoseTime = millis();
+  isBodyPoseStreaming = true;
 }
 
-void RobotAction::GetMoveBodyPoint(Point &point, Point direction)
+bool RobotAction::IsBodyPoseStreaming()
 {
-  point = Point(point.x - direction.x, point.y - direction.y, point.z - direction.z);
+  return isBodyPoseStreaming;
 }
 
-void RobotAction::GetRotateBodyPoints(RobotLegsPoints &points, Point rotateAxis, float rotateAngle)
+bool RobotAction::IsBodyPoseStreamReady()
 {
-  float rotateAxisLength = sqrt(pow(rotateAxis.x, 2) + pow(rotateAxis.y, 2) + pow(rotateAxis.z, 2));
-  if (rotateAxisLength == 0)
+  return robot.state == Robot::State::Action && legsState == LegsState::CrawlState && mode == Mode::Active;
+}
+
+void RobotAction::StartBodyPoseStream()
+{
+  if (IsBodyPoseStreamReady())
+    return;
+
+  ActionState();
+  if (legsState != LegsState::CrawlState)
+    InitialState();
+  if (mode != Mode::Active)
+    ActiveMode();
+}
+
+void RobotAction::UpdateBodyPoseStream()
+{
+  // Called from the loop like the blocking actions, so it never runs while one of them moves the legs
+  // The setpoint is written by the communication in the timer interrupt
+  noInterrupts();
+  if (isBodyPoseStreaming && millis() - streamPoseTime > streamPoseTimeout)
+    isBodyPoseStreaming = false;
+  bool isStreaming = isBodyPoseStreaming;
+  BodyPose pose = streamPose;
+  interrupts();
+
+  if (!isStreaming)
+    return;
+  if (millis() - streamPoseUpdateTime < streamPosePeriod)
+    return;
+  if (!IsBodyPoseStreamReady() || robot.IsBusy())
+    return;
+  streamPoseUpdateTime = millis();
+
+  // Ease toward the setpoint, limiting the change in one tick
+  float t = streamPoseSmoothing;
+  float move = sqrt(pow(pose.GetMoveX() - bodyPose.GetMoveX(), 2) +
+                    pow(pose.GetMoveY() - bodyPose.GetMoveY(), 2) +
+                    pow(pose.GetMoveZ() - bodyPose.GetMoveZ(), 2));
+  if (move * t > streamPoseMaxMove)
+    t = streamPoseMaxMove / move;
+  float rotate = bodyPose.GetRotation().GetAngle(pose.GetRotation());
+  if (rotate * t > streamPoseMaxRotate)
+    t = streamPoseMaxRotate / rotate;
+
+  RobotLegsPoints points;
+  GetGaitPointsNow(points);
+
+  BodyPose lastPose = bodyPose;
+  bodyPose = BodyPose::Slerp(bodyPose, pose, t);
+  GetPosedPoints(points);
+  if (!robot.CheckPoints(points))
   {
-    rotateAxis.x = 0;
-    rotateAxis.y = 0;
-    rotateAxis.z = 1;
+    bodyPose = lastPose;
+    return;
   }
-  else
+
+  robot.MoveToDirectly(points);
+}
+
+void RobotAction::GetGaitPointsNow(RobotLegsPoints &points)
+{
+  robot.GetPointsNow(points);
+  bodyPose.ApplyInverse(points);
+}
+
+void RobotAction::GetPosedPoints(RobotLegsPoints &points)
+{
+  bodyPose.Apply(points);
+}
+
+bool RobotAction::CheckPosedPoints(RobotLegsPoints points)
+{
+  GetPosedPoints(points);
+  return robot.CheckPoints(points);
+}
+
+void RobotAction::ClearBodyPose()
+{
+  if (bodyPose.IsIdentity())
+    return;
+
+  RobotLegsPoints points;
+  GetGaitPointsNow(points);
+
+  bodyPose = BodyPose();
+
+  LegsMoveTo(points, speedTwistBody);
+}
+
+bool RobotAction::ProjectPoints(RobotLegsPoints &points)
+{
+  if (robot.CheckPoints(points))
+    return true;
+
+  RobotLegsPoints pointsNow;
+  robot.GetPointsNow(pointsNow);
+
+  float reached = 0;
+  float unreached = 1;
+  RobotLegsPoints pointsTry;
+  for (byte i = 0; i < projectionSteps; i++)
+  {
+    float fraction = (reached + unreached) / 2;
+    GetInterpolatedPoints(pointsTry, pointsNow, points, fraction);
+    if (robot.CheckPoints(pointsTry))
+      reached = fraction;
+    else
+      unreached = fraction;
+  }
+  if (reached == 0)
+    return false;
+
+  GetInterpolatedPoints(points, pointsNow, points, reached);
+  return true;
+}
+
+float RobotAction::ProjectStep(RobotLegsPoints points1, RobotLegsPoints &points2, RobotLegsPoints &points3)
+{
+  if (CheckStepPoints(points2, points3))
+    return 1;
+
+  // Only the travel is scaled, the swing legs are still lifted and put down to their full heights
+  RobotLegsPoints from2 = points2;
+  RobotLegsPoints from3 = points3;
+  Point *pointsFrom2[6] = { &from2.leg1, &from2.leg2, &from2.leg3, &from2.leg4, &from2.leg5, &from2.leg6 };
+  Point *pointsFrom3[6] = { &from3.leg1, &from3.leg2, &from3.leg3, &from3.leg4, &from3.leg5, &from3.leg6 };
+  Point *pointsStart[6] = { &points1.leg1, &points1.leg2, &points1.leg3, &points1.leg4, &points1.leg5, &points1.leg6 };
+  for (byte i = 0; i < 6; i++)
+  {
+    pointsFrom2[i]->x = pointsFrom3[i]->x = pointsStart[i]->x;
+    pointsFrom2[i]->y = pointsFrom3[i]->y = pointsStart[i]->y;
+  }
+
+  float reached = 0;
+  float unreached = 1;
+  RobotLegsPoints points2Try, points3Try;
+  for (byte i = 0; i < projectionSteps; i++)
   {
-    rotateAxis.x /= rotateAxisLength;
-    rotateAxis.y /= rotateAxisLength;
-    rotateAxis.z /= rotateAxisLength;
+    float fraction = (reached + unreached) / 2;
+    GetInterpolatedPoints(points2Try, from2, points2, fraction);
+    GetInterpolatedPoints(points3Try, from3, points3, fraction);
+    if (CheckStepPoints(points2Try, points3Try))
+      reached = fraction;
+    else
+      unreached = fraction;
   }
+  if (reached == 0)
+    return 0;
 
-  GetRotateBodyPoint(points.leg1, rotateAxis, rotateAngle);
-  GetRotateBodyPoint(points.leg2, rotateAxis, rotateAngle);
-  GetRotateBodyPoint(points.leg3, rotateAxis, rotateAngle);
-  GetRotateBodyPoint(points.leg4, rotateAxis, rotateAngle);
-  GetRotateBodyPoint(points.leg5, rotateAxis, rotateAngle);
-  GetRotateBodyPoint(points.leg6, rotateAxis, rotateAngle);
+  GetInterpolatedPoints(points2, from2, points2, reached);
+  GetInterpolatedPoints(points3, from3, points3, reached);
+  return reached;
 }
 
-void RobotAction::GetRotateBodyPoint(Point &point, Point rotateAxis, float rotateAngle)
+bool RobotAction::CheckStepPoints(RobotLegsPoints points2, RobotLegsPoints points3)
 {
-  Point oldPoint = point;
+  return CheckPosedPoints(points2) && CheckPosedPoints(points3) && CheckCrawlPoints(points2) && CheckCrawlPoints(points3);
+}
 
-  rotateAngle = rotateAngle * PI / 180;
-  float c = cos(rotateAngle);
-  float s = sin(rotateAngle);
+void RobotAction::GetInterpolatedPoints(RobotLegsPoints &points, RobotLegsPoints from, RobotLegsPoints to, float fraction)
+{
+  Point *pointsOut[6] = { &points.leg1, &points.leg2, &points.leg3, &points.leg4, &points.leg5, &points.leg6 };
+  Point *pointsFrom[6] = { &from.leg1, &from.leg2, &from.leg3, &from.leg4, &from.leg5, &from.leg6 };
+  Point *pointsTo[6] = { &to.leg1, &to.leg2, &to.leg3, &to.leg4, &to.leg5, &to.leg6 };
 
-  point.x = (rotateAxis.x * rotateAxis.x * (1 - c) + c) * oldPoint.x + (rotateAxis.x * rotateAxis.y * (1 - c) - rotateAxis.z * s) * oldPoint.y + (rotateAxis.x * rotateAxis.z * (1 - c) + rotateAxis.y * s) * oldPoint.z;
-  point.y = (rotateAxis.y * rotateAxis.x * (1 - c) + rotateAxis.z * s) * oldPoint.x + (rotateAxis.y * rotateAxis.y * (1 - c) + c) * oldPoint.y + (rotateAxis.y * rotateAxis.z * (1 - c) - rotateAxis.x * s) * oldPoint.z;
-  point.z = (rotateAxis.x * rotateAxis.z * (1 - c) - rotateAxis.y * s) * oldPoint.x + (rotateAxis.y * rotateAxis.z * (1 - c) + rotateAxis.x * s) * oldPoint.y + (rotateAxis.z * rotateAxis.z * (1 - c) + c) * oldPoint.z;
+  for (byte i = 0; i < 6; i++)
+  {
+    pointsOut[i]->x = pointsFrom[i]->x + (pointsTo[i]->x - pointsFrom[i]->x) * fraction;
+    pointsOut[i]->y = pointsFrom[i]->y + (pointsTo[i]->y - pointsFrom[i]->y) * fraction;
+    pointsOut[i]->z = pointsFrom[i]->z + (pointsTo[i]->z - pointsFrom[i]->z) * fraction;
+  }
 }
 
 void RobotAction::LegsMoveTo(RobotLegsPoints points)
 {
-  if (!robot.CheckPoints(points))
+  GetPosedPoints(points);
+  if (!ProjectPoints(points))
     return;
 
   robot.MoveTo(points);
@@ -1452,7 +2479,8 @@ void RobotAction::LegsMoveTo(RobotLegsPoints points)
 
 void RobotAction::LegsMoveTo(RobotLegsPoints points, float speed)
 {
-  if (!robot.CheckPoints(points))
+  GetPosedPoints(points);
+  if (!ProjectPoints(points))
     return;
 
   robot.SetSpeed(speed);
@@ -1462,7 +2490,8 @@ void RobotAction::LegsMoveTo(RobotLegsPoints points, float speed)
 
 void RobotAction::LegsMoveTo(RobotLegsPoints points, int leg, float legSpeed)
 {
-  if (!robot.CheckPoints(points))
+  GetPosedPoints(points);
+  if (!ProjectPoints(points))
     return;
 
   float distance[6] = {
@@ -1490,7 +2519,7 @@ void RobotAction::LegsMoveToRelatively(Point point, float speed)
 {
   RobotLegsPoints points;
 
-  robot.GetPointsNow(points);
+  GetGaitPointsNow(points);
   GetCrawlPoints(points, point);
 
   LegsMoveTo(points, speed);
@@ -10,10 +10,26 @@
 #if defined(ARDUINO_AVR_MEGA2560)
 
 #include <Arduino.h>
-#include <Servo.h>
 #include <EEPROM.h>
 #include <FlexiTimer2.h>
 
+#include "ProjectDamsonGaitParams.h"
+#include "ProjectDamsonLimits.h"
+#include "ProjectDamsonBodyPose.h"
+#include "ProjectDamsonCollision.h"
+#include "ProjectDamsonServoDriver.h"
+#include "ProjectDamsonThermal.h"
+#include "ProjectDamsonGovernor.h"
+#include "ProjectDamsonEnergy.h"
+
+#if defined(DAMSON_HOST_SIM)
+// Host simulator hook, advances the simulated control tick while blocking
+void HostSimWait();
+#endif
+
+struct PathPose;
+class FootstepPlan;
+
 class RobotShape
 {
 public:
@@ -52,6 +68,11 @@ public:
   static constexpr float servo31 = 134;
 
   static constexpr float robotState = 140;
+
+  // Pulse range (min, max us) of each servo, 4 bytes each in the order of the offsets above
+  static constexpr float servoPulseRange = 160;
+  // Calibration curve of each servo, 6 bytes each in the same order
+  static constexpr float servoCurve = 240;
 };
 
 class Power
@@ -63,22 +84,53 @@ public:
   bool powerGroupAutoSwitch;
 
   volatile float voltage;
+  // Latest reading alone, drops below voltage while the servos draw a current peak
+  volatile float readingVoltage;
   volatile bool powerGroupState;
 
   void Update();
 
+ /*
+  * Brief     Allow the groups up to this one to be switched on, groups above it are switched off
+  * -----------------------------------------------------------------------------------------------*/
+  void SetPowerGroupLimit(byte group);
+  bool IsPowerGroupOn(byte group);
+
+ /*
+  * Brief     Read another analog pin, the ADC otherwise converts the supply voltage all the time
+  *           Use this instead of analogRead() once Set() has been called
+  * -----------------------------------------------------------------------------------------------*/
+  int ReadAnalog(byte pin);
+
+  // Latest conversion of the free running ADC, written by the ADC interrupt
+  static volatile unsigned int samplingReading;
+
 private:
   const int samplingPin = A7;
   float adcReference;
   float samplingProportion;
-  static const int samplingSize = 25;
-  float samplingData[samplingSize];
-  int samplingDataCounter = 0;
-  static const int samplingPeakSize = 25;
-  float samplingPeakData[samplingPeakSize];
-  int samplingPeakDataCounter = 0;
-
+  bool isSampling = false;
+
+  // Voltage is the average of the last samplingPeakSize peaks, each the maximum of the last
+  // samplingSize readings. Both are kept in ADC counts and updated in constant time per reading.
+  static const byte samplingSize = 25;
+  static const byte samplingPeakSize = 25;
+
+  // Sliding maximum: readings that can still become the maximum, falling from the front
+  unsigned int peakQueueReading[samplingSize];
+  unsigned int peakQueueIndex[samplingSize];
+  byte peakQueueFront = 0;
+  byte peakQueueCount = 0;
+  unsigned int samplingIndex = 0;
+
+  // Running sum of the peaks
+  unsigned int samplingPeakData[samplingPeakSize];
+  byte samplingPeakDataCounter = 0;
+  unsigned int samplingPeakSum = 0;
+
+  void StartSampling();
   void Sampling();
+  void AddReading(unsigned int reading);
 
   const int powerGroup1Pin = A15;
   const int powerGroup2Pin = A13;
@@ -89,6 +141,7 @@ private:
   bool powerGroup1State = false;
   bool powerGroup2State = false;
   bool powerGroup3State = false;
+  volatile byte powerGroupLimit = 0;
 
   void SetPowerGroupState(int group, bool state);
 
@@ -124,22 +177,78 @@ public:
   void SetOffset(float offset);
   void SetOffsetEnableState(bool state);
 
+ /*
+  * Brief     Set the pulse widths of servo angle 0 and 180 of this servo and save them to EEPROM
+  * Param     minPulse, maxPulse    Pulse widths (us), ServoDriver::minPulse~ServoDriver::maxPulse
+  * Retval    Whether the range is valid, also with the calibration curve on it
+  * -----------------------------------------------------------------------------------------------*/
+  bool SetPulseRange(unsigned int minPulse, unsigned int maxPulse);
+  unsigned int GetMinPulse() { return minPulse; }
+  unsigned int GetMaxPulse() { return maxPulse; }
+
+ /*
+  * Brief     Correct the pulse at one knot of the calibration curve and save it to EEPROM
+  *           The curve starts as the straight line of the pulse range, the end knots stay on it
+  * Param     knot          1~5, at servo angle knot * 30
+  *           correction    Pulse correction (us), -63.5~63.5, rounded to 0.5 us
+  * Retval    Whether the curve is valid, the pulse must rise from knot to knot
+  * -----------------------------------------------------------------------------------------------*/
+  bool SetCurveCorrection(byte knot, float correction);
+  float GetCurveCorrection(byte knot);
+  void ClearCurve();
+
   void RotateToDirectly(float jointAngle);
 
+ /*
+  * Brief     Servo angle of a joint angle in 0.01 degree, within the global servo limits
+  *           RotateToDirectly() is GetServoCentidegrees() and then RotateToServoCentidegrees(),
+  *           split so a leg can constrain its three servo angles together in between
+  * Retval    Whether the joint angle is in range of this joint
+  * -----------------------------------------------------------------------------------------------*/
+  bool GetServoCentidegrees(float jointAngle, int &servoCentidegrees);
+  void RotateToServoCentidegrees(float jointAngle, int servoCentidegrees);
+
+ /*
+  * Brief     Joint angle that GetServoCentidegrees() maps to a constrained servo angle
+  * Param     jointAngle: joint angle that was asked for
+  *           servoCentidegrees: its servo angle before the constraints
+  *           constrainedCentidegrees: its servo angle after the constraints
+  * -----------------------------------------------------------------------------------------------*/
+  float GetConstrainedAngle(float jointAngle, int servoCentidegrees, int constrainedCentidegrees);
+
+ /*
+  * Brief     Attach the servo at the last angle it was given
+  *           Joints start disabled, they are moved as usual but the servo gets no pulse
+  *           A servo that had a pulse before, and was detached by Disable(), is assumed to be
+  *           where that pulse left it. It is ramped from there at firstMoveStep per UpdateRamp()
+  *           instead of jumping. At start-up its position is unknown, the first pulse is the goal
+  * -----------------------------------------------------------------------------------------------*/
+  void Enable();
+  void Disable();
+  bool IsEnabled() { return isEnabled; }
+  void UpdateRamp();
+  bool IsRamping() { return isRamping; }
+
+  // Servo travel per control tick of a ramped first move (0.01 degree), 150 degree/s
+  static const int firstMoveStep = 300;
+
   // For motor testing - bypasses joint angle limits (use with caution!)
   void RotateToServoAngle(int servoAngle);
 
   float GetJointAngle(float servoAngle);
 
   bool CheckJointAngle(float jointAngle);
+  float GetMinAngle() { return jointMinAngle; }
+  float GetMaxAngle() { return jointMaxAngle; }
 
   volatile float jointAngleNow;
   volatile float servoAngleNow;
 
+  // Time between servo attaches at start-up (ms)
   static int firstRotateDelay;
 
 private:
-  Servo servo;
+  byte servoChannel = ServoDriver::invalidChannel;
   int servoPin;
   float jointZero;
   bool jointDir;
@@ -149,6 +258,26 @@ private:
   volatile float offset = 0;
   volatile bool isOffsetEnable = true;
   volatile bool isFirstRotate = true;
+  volatile bool isEnabled = false;
+  volatile int servoCentidegreesNow = -1;
+  // Last pulse the servo was given, and where a ramped first move is
+  volatile int servoCentidegreesWritten = -1;
+  volatile int rampCentidegrees = -1;
+  volatile bool isRamping = false;
+  int pulseRangeAddress;
+  unsigned int minPulse = ServoDriver::defaultMinPulse;
+  unsigned int maxPulse = ServoDriver::defaultMaxPulse;
+  int curveAddress;
+  // Corrections of the inner knots in driver ticks
+  static const byte curveCorrections = ServoCurve::knots - 2;
+  static const byte curveValidMark = 0xA5;
+  int8_t curveCorrection[curveCorrections] = {};
+
+  static bool CheckPulseRange(unsigned int minPulse, unsigned int maxPulse);
+  bool GetCurve(ServoCurve &curve, unsigned int minPulse, unsigned int maxPulse, const int8_t correction[curveCorrections]);
+  void SaveCurve();
+  void WriteServo(int servoCentidegrees);
+  void OutputServo(int servoCentidegrees);
 };
 
 class RobotLeg
@@ -157,6 +286,11 @@ public:
   RobotLeg();
   void Set(float xOrigin, float yOrigin, RobotShape robotShape);
 
+ /*
+  * Brief     Set the leg number (1-6), selects the constraints of ProjectDamsonLimits.h
+  * -----------------------------------------------------------------------------------------------*/
+  void SetNumber(byte number);
+
   void SetOffsetEnableState(bool state);
 
   void CalculatePoint(float alpha, float beta, float gamma, volatile float &x, volatile float &y, volatile float &z);
@@ -164,7 +298,18 @@ public:
   void CalculateAngle(float x, float y, float z, float &alpha, float &beta, float &gamma);
   void CalculateAngle(Point point, float &alpha, float &beta, float &gamma);
 
+ /*
+  * Brief     Joints of the leg at these angles, for the collision checker
+  * -----------------------------------------------------------------------------------------------*/
+  void CalculateLinks(float alpha, float beta, float gamma, LegLinks &links);
+
+  float GetXOrigin() { return xOrigin; }
+  float GetYOrigin() { return yOrigin; }
+  // Longest horizontal distance from the hip to any point of the leg
+  float GetReach() { return robotShape.d + robotShape.e + robotShape.f; }
+
   bool CheckPoint(Point point);
+  bool CheckPoint(Point point, float &alpha, float &beta, float &gamma);
   bool CheckAngle(float alpha, float beta, float gamma);
 
   void MoveTo(Point point);
@@ -184,18 +329,33 @@ public:
   Point pointStart;                           // starting point for current motion
   volatile float totalDistance = 0;           // total distance from start to goal
   volatile bool hasTrajectory = false;        // indicates an active eased trajectory
-  volatile unsigned long moveStartMillis = 0; // millis() at start of trajectory
-  volatile unsigned long moveDurationMs = 0;  // planned duration based on speed
+  volatile unsigned long moveUpdateMillis = 0; // millis() at the last trajectory update
+  volatile float moveElapsedMs = 0;            // trajectory time so far, scaled by the governor
+  volatile unsigned long moveDurationMs = 0;   // planned duration based on speed
 
   static constexpr float negligibleDistance = 0.1;
   static constexpr float defaultStepDistance = 2;
   volatile float stepDistance = defaultStepDistance;
 
+  // Inverse kinematics solved and skipped by MoveToDirectly(), for all legs
+  static volatile unsigned long solveCount;
+  static volatile unsigned long skippedSolveCount;
+
 private:
+  byte number = 0;
+  LimitsEngine::Apply applyConstraints = nullptr;
+  // Hip servo angles (0.01 degree) of all legs as last written, for the collision zones
+  static int hipServoCentidegrees[6];
+
   float xOrigin, yOrigin;
   RobotShape robotShape;
   volatile bool isFirstMove = true;
 
+  // Last point solved by MoveToDirectly() and its joint angles, reused while the point is the same
+  bool isSolved = false;
+  Point solvedPoint;
+  float solvedAlpha, solvedBeta, solvedGamma;
+
   void RotateToDirectly(float alpha, float beta, float gamma);
 };
 
@@ -224,13 +384,19 @@ public:
   void MoveTo(RobotLegsPoints points, float speed);
   void MoveToRelatively(Point point);
   void MoveToRelatively(Point point, float speed);
+  void MoveToDirectly(RobotLegsPoints points);
   void WaitUntilFree();
+  bool IsBusy();
 
   void SetSpeed(float speed);
   void SetSpeed(float speed1, float speed2, float speed3, float speed4, float speed5, float speed6);
 
   void SetSpeedMultiple(float multiple);
 
+
+ /*
+  * Brief     Whether every leg can reach its point and no two adjacent legs touch there
+  * -----------------------------------------------------------------------------------------------*/
   bool CheckPoints(RobotLegsPoints points);
 
   void GetPointsNow(RobotLegsPoints &points);
@@ -238,7 +404,83 @@ public:
   void Update();
 
   // For motor testing - set servo angle directly by leg (1-6) and joint (0=A, 1=B, 2=C)
-  void SetServoAngle(int leg, int joint, int angle);
+  // Does not wake the robot up, false while it is in low power or for no such joint
+  bool SetServoAngle(int leg, int joint, int angle);
+  bool SetServoPulseRange(int leg, int joint, unsigned int minPulse, unsigned int maxPulse);
+  bool SetServoCurveCorrection(int leg, int joint, byte knot, float correction);
+  RobotJoint *GetJoint(int leg, int joint);
+
+  struct OutputCounts
+  {
+    unsigned long solves, skippedSolves;
+    unsigned long servoWrites, skippedServoWrites;
+  };
+
+ /*
+  * Brief     Work done and avoided on the servo output path, since start or the last reset
+  * -----------------------------------------------------------------------------------------------*/
+  OutputCounts GetOutputCounts();
+  void ResetOutputCounts();
+
+  struct LoopTiming
+  {
+    unsigned long periodMicros;     // Between the last two control ticks
+    unsigned long updateMicros;     // Work of the last control tick
+    unsigned long maxUpdateMicros;  // Longest work since the last reset
+  };
+
+ /*
+  * Brief     Timing of the control loop, Update() every 20 ms
+  * Param     resetMax    Start the maximum again after reading
+  * -----------------------------------------------------------------------------------------------*/
+  LoopTiming GetLoopTiming(bool resetMax = false);
+
+ /*
+  * Brief     Whether the start-up sequence has attached every servo
+  * -----------------------------------------------------------------------------------------------*/
+  bool IsPoweredUp();
+
+ /*
+  * Brief     Detach every servo and switch off the power groups once the legs are free
+  *           Update() runs lowPowerTickDivider times slower until WakeUp(), the communication
+  *           is still served every control tick
+  * -----------------------------------------------------------------------------------------------*/
+  void LowPowerState();
+
+ /*
+  * Brief     Attach the servos again at the points they were left at, as at start-up
+  *           Returns when every servo is attached, or after wakeTimeout if the supply is too low
+  * -----------------------------------------------------------------------------------------------*/
+  void WakeUp();
+  bool IsLowPower() { return isLowPower; }
+
+  static const byte lowPowerTickDivider = 5;
+  static const unsigned long wakeTimeout = 2000;
+
+ /*
+  * Brief     Estimated heat of one servo, 1 is its budget, see ProjectDamsonThermal.h
+  *           Moves are slowed down by GetSpeedThrottle() while a joint is near its budget
+  * -----------------------------------------------------------------------------------------------*/
+  float GetJointHeat(int leg, int joint);
+  float GetSpeedThrottle();
+
+ /*
+  * Brief     Speed factor of moves for the supply, see ProjectDamsonGovernor.h
+  *           A move in progress follows it too, so low or sagging supply slows it down at once
+  * -----------------------------------------------------------------------------------------------*/
+  float GetSupplySpeed();
+  unsigned int GetDeratingCount();
+  SupplyGovernor::Event GetLastDerating();
+
+ /*
+  * Brief     Estimated energy of the gait, see ProjectDamsonEnergy.h
+  *           RobotAction adds every crawl step that is moved, with the distance it covered
+  *           The loops are counted from the last reset
+  * -----------------------------------------------------------------------------------------------*/
+  void AddGaitStep(float distance, byte stepsPerCycle);
+  EnergyMeter::Report GetLastGaitCycle();
+  EnergyMeter::Report GetGaitEnergy();
+  void ResetGaitEnergy();
 
   RobotLeg leg1, leg2, leg3, leg4, leg5, leg6;
 
@@ -276,11 +518,46 @@ private:
   void UpdateAction();
   void UpdateLegAction(RobotLeg &leg);
 
-  void MoveToDirectly(RobotLegsPoints points);
-
   void SetOffsetEnableState(bool state);
 
   RobotShape robotShape;
+
+  // Start-up sequence, one power group after another and one servo at a time in each group
+  static const byte powerUpServos = 18;
+  static const byte servosPerPowerGroup = 6;
+  static const byte powerGroupSettleTicks = 2;
+  static const byte powerUpOrder[powerUpServos][2];
+  volatile byte powerUpIndex = 0;
+  volatile byte powerUpGroup = 0;
+  volatile byte powerUpCounter = 0;
+  volatile bool isLowPower = false;
+
+  void UpdatePowerUp();
+
+  LegCollision collision;
+
+  void SetCollisionTables();
+  bool CheckCollisions(const float alpha[6], const float beta[6], const float gamma[6]);
+
+  JointThermal thermal;
+  static const byte thermalUpdateTicks = 5;
+  // Feet within this height of the lowest foot carry the body
+  static constexpr float stanceTolerance = 5;
+  byte thermalCounter = 0;
+  unsigned long thermalUpdateTime = 0;
+
+  void UpdateThermal();
+  float UpdateLegThermal(RobotLeg &leg, byte firstJoint, float weightShare, float seconds);
+
+  EnergyMeter energy;
+
+  SupplyGovernor governor;
+  unsigned long governorUpdateTime = 0;
+
+  LoopTiming loopTiming = {};
+  unsigned long lastUpdateMicros = 0;
+
+  void UpdateGovernor();
 };
 
 class RobotAction
@@ -291,9 +568,11 @@ public:
 
   void SetSpeedMultiple(float multiple);
   void SetActionGroup(int group);
+  void SetGaitParams(GaitParams params);
 
   void ActiveMode();
-  void SleepMode();
+  // false if the body could not be lowered, it is lifted back and the servos stay powered
+  bool SleepMode();
   void SwitchMode();
 
   void CrawlForward();
@@ -304,13 +583,27 @@ public:
   void TurnRight();
 
   void Crawl(float x, float y, float angle);
+  void CrawlArc(float xCentre, float yCentre, float angle);
+  bool CrawlPath(const PathPose poses[], int count);
 
   void ChangeBodyHeight(float height);
 
   void MoveBody(float x, float y, float z);
   void RotateBody(float x, float y, float z);
 
+ /*
+  * Brief     Pose the body on top of the crawl gait
+  *           The move z is relative to the height of ChangeBodyHeight(), not to the default height.
+  *           It is limited so the body stays 0 ~ 45 mm above the default height.
+  * -----------------------------------------------------------------------------------------------*/
   void TwistBody(Point move, Point rotate);
+  void TwistBody(BodyPose pose);
+
+  void StreamBodyPose(BodyPose pose);
+  bool IsBodyPoseStreaming();
+  bool IsBodyPoseStreamReady();
+  void StartBodyPoseStream();
+  void UpdateBodyPoseStream();
 
   void InitialState();
 
@@ -318,6 +611,8 @@ public:
 
   void LegMoveToRelativelyDirectly(int leg, Point point);
 
+  void ShiftBodyForSwing(int leg);
+
   Robot robot;
 
 private:
@@ -333,19 +628,32 @@ private:
   enum LegsState
   {
     CrawlState,
-    TwistBodyState,
     LegMoveState
   };
   LegsState legsState = LegsState::CrawlState;
 
   RobotLegsPoints initialPoints;
-  RobotLegsPoints lastChangeLegsStatePoints;
 
-  const float crawlLength = 42;
+  // Body pose applied on top of the gait, the crawl plans feet without it
+  BodyPose bodyPose;
+
+  void GetGaitPointsNow(RobotLegsPoints &points);
+  void GetPosedPoints(RobotLegsPoints &points);
+  bool CheckPosedPoints(RobotLegsPoints points);
+  void ClearBodyPose();
+  // Whether every foot is at the ground height of the sleep mode (z 0), the body rests on the ground
+  bool IsBodyDown();
+  const float bodyDownTolerance = 2;
+
+  // Stride of straight steps, turns and arcs are limited by turnAngle and maxArcChord instead
+  float crawlLength = GaitParamSets::group1.crawlLength;
   const float turnAngle = 18;
+  // Largest chord of a foot in one loop of an arc (mm), a little more than the 40 mm of the
+  // outer feet in a turn on the spot by turnAngle, so such a turn is only limited by turnAngle
+  const float maxArcChord = 45;
 
-  const float legLift = 20;
-  const float legLiftSpeed = 7.5;
+  float legLift = GaitParamSets::group1.legLift;
+  float legLiftSpeed = GaitParamSets::group1.legLiftSpeed;
   const float defaultBodyLift = 15;
   float bodyLift = defaultBodyLift;
   const float bodyLiftSpeed = 1;
@@ -355,23 +663,78 @@ private:
   int crawlSteps = 2;
   int legMoveIndex = 1;
 
+  const float stabilityMargin = 15;
+  const float maxBodySway = 20;
+
+  byte GetSwingLegs(int index);
+  void SetSwingLegsPoints(RobotLegsPoints &points, RobotLegsPoints swingPoints, byte swingLegs);
+  // Sway the body during an accepted step, the stance feet of points2 and points3 move with it
+  void AddBodySway(RobotLegsPoints &points2, RobotLegsPoints &points3, byte swingLegs);
+
   bool CheckCrawlPoints(RobotLegsPoints points);
 
   void GetCrawlPoints(RobotLegsPoints &points, Point point);
   void GetCrawlPoint(Point &point, Point direction);
 
-  void GetTurnPoints(RobotLegsPoints &points, float angle);
   void GetTurnPoint(Point &point, float angle);
 
-  const float speedTwistBody = 1.25;
+  void CrawlStep(Point move, Point centre, float angle);
+  void CrawlLegsStep(Point move, Point centre, float angle, RobotLegsPoints points4, RobotLegsPoints points5);
 
-  void TwistBody(Point move, Point rotateAxis, float rotateAngle);
+  const int maxPathRefines = 4;
+
+  bool GetPathPlan(FootstepPlan &plan, const PathPose poses[], int count);
+  int CheckPathPlan(FootstepPlan &plan);
+  void GetPathSwingPoints(FootstepPlan &plan, int step, RobotLegsPoints &points4, RobotLegsPoints &points5);
+  void GetPathLandingPoints(FootstepPlan &plan, int step, RobotLegsPoints &points, float lookAhead);
+
+  Point GetArcCentre(float x, float y, float angle);
+  float GetArcLimitAngle(Point centre, float angle);
 
-  void GetMoveBodyPoints(RobotLegsPoints &points, Point point);
-  void GetMoveBodyPoint(Point &point, Point direction);
+  void GetArcPoints(RobotLegsPoints &points, Point move, Point centre, float angle, float fraction);
+  void GetArcPoint(Point &point, Point centre, float angle);
 
-  void GetRotateBodyPoints(RobotLegsPoints &points, Point rotateAxis, float rotateAngle);
-  void GetRotateBodyPoint(Point &point, Point rotateAxis, float rotateAngle);
+  const float speedTwistBody = 1.25;
+  const float maxBodyMove = 30;
+  const float maxBodyHeight = 45;
+  const float maxBodyRotate = 15;
+
+  void TwistBody(Point move, Point rotateAxis, float rotateAngle);
+  BodyPose ConstrainBodyPose(BodyPose pose);
+
+  // Body pose stream, the setpoint is written by the communication and followed once per control tick
+  volatile bool isBodyPoseStreaming = false;
+  BodyPose streamPose;
+  volatile unsigned long streamPoseTime = 0;
+  const unsigned long streamPoseTimeout = 500;
+  unsigned long streamPoseUpdateTime = 0;
+  const unsigned long streamPosePeriod = 20;
+  const float streamPoseSmoothing = 0.3;
+  const float streamPoseMaxMove = 3;
+  const float streamPoseMaxRotate = 1.5;
+
+  // Halvings of the move when a goal is out of reach, the last one is 1/64 of the move
+  static const byte projectionSteps = 6;
+
+ /*
+  * Brief     Bring posed goal points that can not all be reached back toward the points now
+  *           Every foot is moved the same fraction of its way, the largest fraction found that
+  *           every leg can reach. A body move is scaled down instead of dropped.
+  * Retval    false if no part of the move can be reached, the points are unchanged then
+  * -----------------------------------------------------------------------------------------------*/
+  bool ProjectPoints(RobotLegsPoints &points);
+
+ /*
+  * Brief     Scale a crawl step that can not all be reached, before any of it is moved
+  *           The horizontal travel of the lifted points2 and the landed points3 is brought back
+  *           toward points1 by the same fraction, so the lift, swing and lowering stay one step of
+  *           that length. The heights are kept, a short swing still clears the ground.
+  * Retval    The fraction of the step that is kept, 0 if none of it can be reached
+  * -----------------------------------------------------------------------------------------------*/
+  float ProjectStep(RobotLegsPoints points1, RobotLegsPoints &points2, RobotLegsPoints &points3);
+  // Whether the posed points are in reach and the hip angles of the crawl points are in range
+  bool CheckStepPoints(RobotLegsPoints points2, RobotLegsPoints points3);
+  void GetInterpolatedPoints(RobotLegsPoints &points, RobotLegsPoints from, RobotLegsPoints to, float fraction);
 
   void LegsMoveTo(RobotLegsPoints points);
   void LegsMoveTo(RobotLegsPoints points, float speed);
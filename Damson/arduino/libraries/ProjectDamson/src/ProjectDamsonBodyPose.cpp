@@ -0,0 +1,198 @@
+/*
+ * File       Body pose for Project Damson
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include "ProjectDamsonBasic.h"
+#include "ProjectDamsonBodyPose.h"
+
+Quaternion::Quaternion() : w(1), x(0), y(0), z(0) {}
+
+Quaternion::Quaternion(float w, float x, float y, float z) : w(w), x(x), y(y), z(z) {}
+
+Quaternion Quaternion::FromAxisAngle(float x, float y, float z, float angle)
+{
+  float length = sqrt(x * x + y * y + z * z);
+  if (length == 0)
+    return Quaternion();
+
+  float radian = angle * PI / 180 / 2;
+  float s = sin(radian) / length;
+  return Quaternion(cos(radian), x * s, y * s, z * s);
+}
+
+Quaternion Quaternion::FromEuler(float roll, float pitch, float yaw)
+{
+  float cr = cos(roll * PI / 180 / 2), sr = sin(roll * PI / 180 / 2);
+  float cp = cos(pitch * PI / 180 / 2), sp = sin(pitch * PI / 180 / 2);
+  float cy = cos(yaw * PI / 180 / 2), sy = sin(yaw * PI / 180 / 2);
+
+  // yaw * pitch * roll
+  return Quaternion(
+      cr * cp * cy + sr * sp * sy,
+      sr * cp * cy - cr * sp * sy,
+      cr * sp * cy + sr * cp * sy,
+      cr * cp * sy - sr * sp * cy);
+}
+
+Quaternion Quaternion::Slerp(Quaternion from, Quaternion to, float t)
+{
+  float dot = from.w * to.w + from.x * to.x + from.y * to.y + from.z * to.z;
+  if (dot < 0)
+  {
+    to = Quaternion(-to.w, -to.x, -to.y, -to.z);
+    dot = -dot;
+  }
+
+  float k0, k1;
+  if (dot > 0.9995)
+  {
+    // Nearly the same rotation, interpolate linearly
+    k0 = 1 - t;
+    k1 = t;
+  }
+  else
+  {
+    float theta = acos(dot);
+    float s = sin(theta);
+    k0 = sin((1 - t) * theta) / s;
+    k1 = sin(t * theta) / s;
+  }
+
+  Quaternion result(
+      from.w * k0 + to.w * k1,
+      from.x * k0 + to.x * k1,
+      from.y * k0 + to.y * k1,
+      from.z * k0 + to.z * k1);
+  result.Normalize();
+  return result;
+}
+
+void Quaternion::Normalize()
+{
+  float length = sqrt(w * w + x * x + y * y + z * z);
+  if (length == 0)
+  {
+    *this = Quaternion();
+    return;
+  }
+  w /= length;
+  x /= length;
+  y /= length;
+  z /= length;
+}
+
+float Quaternion::GetAngle() const
+{
+  return 2 * acos(constrain(abs(w), 0, 1)) * 180 / PI;
+}
+
+float Quaternion::GetAngle(Quaternion to) const
+{
+  // Angle of the rotation taking this one to the other
+  float dot = w * to.w + x * to.x + y * to.y + z * to.z;
+  return 2 * acos(constrain(abs(dot), 0, 1)) * 180 / PI;
+}
+
+BodyPose::BodyPose()
+{
+  UpdateMatrix();
+}
+
+BodyPose::BodyPose(float xMove, float yMove, float zMove, Quaternion rotation)
+    : xMove(xMove), yMove(yMove), zMove(zMove), rotation(rotation)
+{
+  this->rotation.Normalize();
+  UpdateMatrix();
+}
+
+BodyPose BodyPose::Slerp(const BodyPose &from, const BodyPose &to, float t)
+{
+  return BodyPose(
+      from.xMove + (to.xMove - from.xMove) * t,
+      from.yMove + (to.yMove - from.yMove) * t,
+      from.zMove + (to.zMove - from.zMove) * t,
+      Quaternion::Slerp(from.rotation, to.rotation, t));
+}
+
+void BodyPose::SetMove(float x, float y, float z)
+{
+  xMove = x;
+  yMove = y;
+  zMove = z;
+}
+
+void BodyPose::SetRotation(Quaternion rotation)
+{
+  this->rotation = rotation;
+  this->rotation.Normalize();
+  UpdateMatrix();
+}
+
+bool BodyPose::IsIdentity() const
+{
+  return xMove == 0 && yMove == 0 && zMove == 0 &&
+         rotation.x == 0 && rotation.y == 0 && rotation.z == 0;
+}
+
+void BodyPose::UpdateMatrix()
+{
+  float w = rotation.w, x = rotation.x, y = rotation.y, z = rotation.z;
+
+  matrix[0][0] = 1 - 2 * (y * y + z * z);
+  matrix[0][1] = 2 * (x * y - w * z);
+  matrix[0][2] = 2 * (x * z + w * y);
+  matrix[1][0] = 2 * (x * y + w * z);
+  matrix[1][1] = 1 - 2 * (x * x + z * z);
+  matrix[1][2] = 2 * (y * z - w * x);
+  matrix[2][0] = 2 * (x * z - w * y);
+  matrix[2][1] = 2 * (y * z + w * x);
+  matrix[2][2] = 1 - 2 * (x * x + y * y);
+}
+
+void BodyPose::Apply(RobotLegsPoints &points) const
+{
+  Apply(points.leg1);
+  Apply(points.leg2);
+  Apply(points.leg3);
+  Apply(points.leg4);
+  Apply(points.leg5);
+  Apply(points.leg6);
+}
+
+void BodyPose::ApplyInverse(RobotLegsPoints &points) const
+{
+  ApplyInverse(points.leg1);
+  ApplyInverse(points.leg2);
+  ApplyInverse(points.leg3);
+  ApplyInverse(points.leg4);
+  ApplyInverse(points.leg5);
+  ApplyInverse(points.leg6);
+}
+
+void BodyPose::Apply(Point &point) const
+{
+  float x = point.x - xMove;
+  float y = point.y - yMove;
+  float z = point.z - zMove;
+
+  point.x = matrix[0][0] * x + matrix[0][1] * y + matrix[0][2] * z;
+  point.y = matrix[1][0] * x + matrix[1][1] * y + matrix[1][2] * z;
+  point.z = matrix[2][0] * x + matrix[2][1] * y + matrix[2][2] * z;
+}
+
+void BodyPose::ApplyInverse(Point &point) const
+{
+  // The inverse of a rotation matrix is its transpose
+  float x = point.x, y = point.y, z = point.z;
+
+  point.x = matrix[0][0] * x + matrix[1][0] * y + matrix[2][0] * z + xMove;
+  point.y = matrix[0][1] * x + matrix[1][1] * y + matrix[2][1] * z + yMove;
+  point.z = matrix[0][2] * x + matrix[1][2] * y + matrix[2][2] * z + zMove;
+}
+
+#endif
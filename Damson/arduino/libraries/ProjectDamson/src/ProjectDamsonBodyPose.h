@@ -0,0 +1,87 @@
+/*
+ * File       Body pose for Project Damson
+ * Project    Project Damson
+ * Brief      Body translation and rotation applied to the feet points.
+ *            The rotation is kept as a quaternion and turned into a rotation matrix once per pose,
+ *            so posing the six legs is one 3x3 multiply each.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+#if defined(ARDUINO_AVR_MEGA2560)
+
+class Point;
+class RobotLegsPoints;
+
+class Quaternion
+{
+public:
+  Quaternion();
+  Quaternion(float w, float x, float y, float z);
+
+ /*
+  * Brief     Rotation around an axis
+  * Param     x, y, z   The axis, need not be normalized. A zero axis gives no rotation
+  *           angle     Rotate angle (degree)
+  * -----------------------------------------------------------------------------------------------*/
+  static Quaternion FromAxisAngle(float x, float y, float z, float angle);
+
+ /*
+  * Brief     Rotation from Euler angles, applied roll (x), then pitch (y), then yaw (z)
+  * Param     roll, pitch, yaw    Rotate angles (degree)
+  * -----------------------------------------------------------------------------------------------*/
+  static Quaternion FromEuler(float roll, float pitch, float yaw);
+
+ /*
+  * Brief     Spherical linear interpolation along the shorter arc
+  * Param     t     0 gives from, 1 gives to
+  * -----------------------------------------------------------------------------------------------*/
+  static Quaternion Slerp(Quaternion from, Quaternion to, float t);
+
+  void Normalize();
+  float GetAngle() const;
+  float GetAngle(Quaternion to) const;
+
+  float w, x, y, z;
+};
+
+class BodyPose
+{
+public:
+  BodyPose();
+  BodyPose(float xMove, float yMove, float zMove, Quaternion rotation);
+
+ /*
+  * Brief     Interpolate between poses, the move linearly and the rotation by slerp
+  * -----------------------------------------------------------------------------------------------*/
+  static BodyPose Slerp(const BodyPose &from, const BodyPose &to, float t);
+
+  void SetMove(float x, float y, float z);
+  void SetRotation(Quaternion rotation);
+
+  float GetMoveX() const { return xMove; }
+  float GetMoveY() const { return yMove; }
+  float GetMoveZ() const { return zMove; }
+  Quaternion GetRotation() const { return rotation; }
+
+  bool IsIdentity() const;
+
+ /*
+  * Brief     Pose the feet points, moved opposite to the body and then rotated
+  *           ApplyInverse() gives the points without the pose back
+  * -----------------------------------------------------------------------------------------------*/
+  void Apply(RobotLegsPoints &points) const;
+  void ApplyInverse(RobotLegsPoints &points) const;
+
+private:
+  float xMove = 0, yMove = 0, zMove = 0;
+  Quaternion rotation;
+  float matrix[3][3];
+
+  void UpdateMatrix();
+  void Apply(Point &point) const;
+  void ApplyInverse(Point &point) const;
+};
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * File       Leg collision checker for Project Damson
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include "ProjectDamsonCollision.h"
+
+const byte LegCollision::pairs[pairCount][2] = { { 1, 2 }, { 2, 3 }, { 4, 5 }, { 5, 6 } };
+
+namespace {
+
+  inline float Dot(const float a[3], const float b[3])
+  {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+  }
+
+  inline float Clamp01(float value)
+  {
+    return value < 0 ? 0 : (value > 1 ? 1 : value);
+  }
+
+}
+
+void LegCollision::SetPair(byte pair, float xOrigin1, float yOrigin1, float minAngle1, float maxAngle1,
+                           float xOrigin2, float yOrigin2, float minAngle2, float maxAngle2, float reach)
+{
+  if (pair >= pairCount)
+    return;
+
+  Pair &table = pairTables[pair];
+  table.minAngle1 = minAngle1;
+  table.minAngle2 = minAngle2;
+  table.bins1 = min((int)maxBins, (int)ceil((maxAngle1 - minAngle1) / binAngle));
+  table.bins2 = min((int)maxBins, (int)ceil((maxAngle2 - minAngle2) / binAngle));
+
+  // Seen from above a leg lies on the line from its hip along the hip angle, and within the bin
+  // it sweeps a wedge. The wedge is covered by its middle line widened by the half chord.
+  float clearance = 2 * linkRadius + 2 * reach * sin(binAngle / 2 * PI / 180);
+
+  for (byte i = 0; i < table.bins1; i++)
+  {
+    float angle1 = (minAngle1 + (i + 0.5) * binAngle) * PI / 180;
+    float p1[3] = { xOrigin1, yOrigin1, 0 };
+    float q1[3] = { xOrigin1 + reach * cos(angle1), yOrigin1 + reach * sin(angle1), 0 };
+
+    table.safe[i] = 0;
+    for (byte j = 0; j < table.bins2; j++)
+    {
+      float angle2 = (minAngle2 + (j + 0.5) * binAngle) * PI / 180;
+      float p2[3] = { xOrigin2, yOrigin2, 0 };
+      float q2[3] = { xOrigin2 + reach * cos(angle2), yOrigin2 + reach * sin(angle2), 0 };
+
+      if (GetSegmentDistance(p1, q1, p2, q2) > clearance)
+        table.safe[i] |= (uint16_t)1 << j;
+    }
+  }
+}
+
+bool LegCollision::IsSafe(byte pair, float alpha1, float alpha2)
+{
+  if (pair >= pairCount)
+    return false;
+
+  const Pair &table = pairTables[pair];
+  int bin1 = GetBin(alpha1, table.minAngle1, table.bins1);
+  int bin2 = GetBin(alpha2, table.minAngle2, table.bins2);
+  if (bin1 < 0 || bin2 < 0)
+    return false;
+  return table.safe[bin1] & ((uint16_t)1 << bin2);
+}
+
+int LegCollision::GetBin(float alpha, float minAngle, byte bins)
+{
+  // Same wrap as RobotJoint::CheckJointAngle()
+  while (alpha >= minAngle + 360)
+    alpha -= 360;
+  while (alpha < minAngle)
+    alpha += 360;
+
+  int bin = (alpha - minAngle) / binAngle;
+  return bin < bins ? bin : -1;
+}
+
+bool LegCollision::CheckLinks(const LegLinks &links1, const LegLinks &links2)
+{
+  for (byte i = 0; i < LegLinks::joints - 1; i++)
+  {
+    float p1[3] = { links1.x[i], links1.y[i], links1.z[i] };
+    float q1[3] = { links1.x[i + 1], links1.y[i + 1], links1.z[i + 1] };
+    for (byte j = 0; j < LegLinks::joints - 1; j++)
+    {
+      float p2[3] = { links2.x[j], links2.y[j], links2.z[j] };
+      float q2[3] = { links2.x[j + 1], links2.y[j + 1], links2.z[j + 1] };
+      if (GetSegmentDistance(p1, q1, p2, q2) < 2 * linkRadius)
+        return false;
+    }
+  }
+  return true;
+}
+
+float LegCollision::GetSegmentDistance(const float p1[3], const float q1[3], const float p2[3], const float q2[3])
+{
+  // Closest points p1 + s * d1 and p2 + t * d2, s and t in 0~1
+  float d1[3] = { q1[0] - p1[0], q1[1] - p1[1], q1[2] - p1[2] };
+  float d2[3] = { q2[0] - p2[0], q2[1] - p2[1], q2[2] - p2[2] };
+  float r[3] = { p1[0] - p2[0], p1[1] - p2[1], p1[2] - p2[2] };
+  float a = Dot(d1, d1);
+  float e = Dot(d2, d2);
+  float f = Dot(d2, r);
+  float s, t;
+
+  if (a <= 0 && e <= 0)
+  {
+    s = t = 0;
+  }
+  else if (a <= 0)
+  {
+    s = 0;
+    t = Clamp01(f / e);
+  }
+  else
+  {
+    float c = Dot(d1, r);
+    if (e <= 0)
+    {
+      t = 0;
+      s = Clamp01(-c / a);
+    }
+    else
+    {
+      float b = Dot(d1, d2);
+      float denom = a * e - b * b;
+      // Parallel segments have no single closest pair, any s works
+      s = denom > 0 ? Clamp01((b * f - c * e) / denom) : 0;
+      t = (b * s + f) / e;
+      if (t < 0)
+      {
+        t = 0;
+        s = Clamp01(-c / a);
+      }
+      else if (t > 1)
+      {
+        t = 1;
+        s = Clamp01((b - c) / a);
+      }
+    }
+  }
+
+  float dx = r[0] + d1[0] * s - d2[0] * t;
+  float dy = r[1] + d1[1] * s - d2[1] * t;
+  float dz = r[2] + d1[2] * s - d2[2] * t;
+  return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * File       Leg collision checker for Project Damson
+ * Project    Project Damson
+ * Brief      Checks the adjacent legs 1-2, 2-3, 4-5 and 5-6 against each other.
+ *            Each link (coxa, femur, tibia) is a capsule, a segment between two joints with the
+ *            radius linkRadius, and two legs touch if any two of their links are closer than
+ *            twice the radius. The joints come from forward kinematics of the planned angles.
+ *            Most poses keep the legs far apart, a table of hip angle pairs built at start-up
+ *            marks those that are safe whatever the femur and tibia do, so only the rest are
+ *            measured link by link.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include <Arduino.h>
+
+// Joints of one leg in body coordinates (mm): hip, femur, tibia and the foot
+struct LegLinks
+{
+  static const byte joints = 4;
+
+  float x[joints];
+  float y[joints];
+  float z[joints];
+};
+
+class LegCollision
+{
+public:
+  // Half width of the links with the servo bodies on them (mm)
+  static constexpr float linkRadius = 9;
+
+  // Adjacent legs, by leg number (1-6)
+  static const byte pairCount = 4;
+  static const byte pairs[pairCount][2];
+
+  // Hip angles are binned in binAngle steps from the minimum of each hip joint
+  static constexpr float binAngle = 10;
+  static const byte maxBins = 16;
+
+ /*
+  * Brief     Build the safety table of one pair
+  * Param     xOrigin, yOrigin    Hip of each leg
+  *           minAngle, maxAngle  Range of each hip joint angle (degree), as RobotJoint checks it
+  *           reach               Longest horizontal distance from a hip to any point of its leg
+  * -----------------------------------------------------------------------------------------------*/
+  void SetPair(byte pair, float xOrigin1, float yOrigin1, float minAngle1, float maxAngle1,
+               float xOrigin2, float yOrigin2, float minAngle2, float maxAngle2, float reach);
+
+ /*
+  * Brief     Whether the legs of a pair can not touch at these hip angles
+  *           The angles must come from the inverse kinematics, which puts the foot in front of
+  *           the hip. false does not mean they touch, CheckLinks() tells that
+  * -----------------------------------------------------------------------------------------------*/
+  bool IsSafe(byte pair, float alpha1, float alpha2);
+
+ /*
+  * Brief     Whether two legs are clear of each other, link by link
+  * -----------------------------------------------------------------------------------------------*/
+  static bool CheckLinks(const LegLinks &links1, const LegLinks &links2);
+
+ /*
+  * Brief     Shortest distance between the segments p1-q1 and p2-q2, in 3D or in 2D (z = 0)
+  * -----------------------------------------------------------------------------------------------*/
+  static float GetSegmentDistance(const float p1[3], const float q1[3], const float p2[3], const float q2[3]);
+
+private:
+  struct Pair
+  {
+    float minAngle1, minAngle2;
+    byte bins1, bins2;
+    // Bit j of row i is set if bin i of the first hip and bin j of the second are safe
+    uint16_t safe[maxBins];
+  };
+
+  Pair pairTables[pairCount] = {};
+
+  static int GetBin(float alpha, float minAngle, byte bins);
+};
+
+#endif
@@ -83,107 +83,220 @@ void Communication::StartSerial()
 void Communication::UpdateSerial()
 {
   while (Serial.available() > 0)
+    ReceiveByte(serialInFrame, Serial.read(), OrderSource::FromSerial);
+  UpdateTransmitSerial();
+}
+
+bool Communication::SendDataSerial(byte* buffer, byte length)
+{
+  byte bufferUsed = serialOutTail - serialOutHead;
+  if (length == 0 || length > serialOutBufferSize - bufferUsed)
+    return false;
+
+  for (byte i = 0; i < length; i++)
+    serialOutBuffer[serialOutTail++ % serialOutBufferSize] = buffer[i];
+
+  UpdateTransmitSerial();
+  return true;
+}
+
+void Communication::UpdateTransmitSerial()
+{
+  // Serial.write() waits when its 64 byte buffer is full, so only what fits is written
+  int room = Serial.availableForWrite();
+  while (room-- > 0 && serialOutHead != serialOutTail)
+    Serial.write(serialOutBuffer[serialOutHead++ % serialOutBufferSize]);
+}
+
+void Communication::ReceiveByte(InFrame &frame, byte inByte, OrderSource orderSource)
+{
+  // transStart starts a legacy frame again anywhere but inside a v2 frame, where it is data
+  // The first COBS code byte of a v2 frame is at most its length, so it is never transStart
+  if (inByte == Orders::transStart && (frame.state != FrameState::FrameV2 || frame.counter == 0))
   {
-    byte inByte = Serial.read();
-    if (inByte == Orders::transStart)
-      serialInDataCounter = 0;
-    serialInData[serialInDataCounter++] = inByte;
-    if (inByte == Orders::transEnd)
-      if (serialInData[0] == Orders::transStart)
-      {
-        HandleOrder(serialInData, OrderSource::FromSerial);
-        serialInDataCounter = 0;
-      }
+    frame.state = FrameState::FrameLegacy;
+    frame.counter = 0;
+  }
+  else if (frame.state == FrameState::FrameNone)
+  {
+    if (inByte == Orders::frameDelimiter)
+    {
+      frame.state = FrameState::FrameV2;
+      frame.counter = 0;
+    }
+    return;
+  }
+  else if (frame.state == FrameState::FrameV2 && inByte == Orders::frameDelimiter)
+  {
+    // The delimiter that ends a frame also starts the next one, repeated delimiters are empty frames
+    if (frame.counter > 0)
+    {
+      ReceiveFrame(frame.data, frame.counter, orderSource);
+      frame.counter = 0;
+    }
+    return;
+  }
+
+  if (frame.counter >= inDataSize)
+  {
+    frame.state = FrameState::FrameNone;
+    return;
+  }
+  frame.data[frame.counter++] = inByte;
+
+  if (frame.state == FrameState::FrameLegacy && inByte == Orders::transEnd)
+  {
+    HandleOrder(frame.data, orderSource);
+    frame.state = FrameState::FrameNone;
   }
 }
 
+void Communication::ReceiveFrame(byte frame[], byte length, OrderSource orderSource)
+{
+  byte packet[inDataSize];
+  length = FrameCodec::Decode(frame, length, packet);
+  length = FrameCodec::CheckCrc(packet, length);
+  // At least the sequence and the order
+  if (length < 2)
+    return;
+  HandleOrderV2(packet, length, orderSource);
+}
+
+void Communication::SendOrder(byte data[], byte length, OrderSource orderSource, byte linkId, Protocol protocol, byte sequence)
+{
+  // Delimiters and the COBS code byte around the largest packet
+  byte outData[maxPacketSize + 3];
+  byte outDataCounter = 0;
+
+  if (protocol == Protocol::Legacy)
+  {
+    outData[outDataCounter++] = Orders::transStart;
+    for (byte i = 0; i < length && outDataCounter < outDataSize - 1; i++)
+      outData[outDataCounter++] = data[i];
+    outData[outDataCounter++] = Orders::transEnd;
+  }
+  else
+  {
+    // Sequence, data and CRC, encoded between the delimiters
+    byte packet[maxPacketSize];
+    byte packetLength = 0;
+    packet[packetLength++] = sequence;
+    for (byte i = 0; i < length && packetLength < maxPacketSize - FrameCodec::crcSize; i++)
+      packet[packetLength++] = data[i];
+    packetLength = FrameCodec::AddCrc(packet, packetLength);
+
+    outData[outDataCounter++] = Orders::frameDelimiter;
+    outDataCounter += FrameCodec::Encode(packet, packetLength, outData + outDataCounter);
+    outData[outDataCounter++] = Orders::frameDelimiter;
+  }
+
+  if (orderSource == OrderSource::FromSerial)
+    SendDataSerial(outData, outDataCounter);
+  else if (orderSource == OrderSource::FromESP8266)
+    SendDataESP8266(linkId, outData, outDataCounter);
+}
+
 //#define DEBUG_ESP8266       // If define, will send ESP8266 debug message to USB serial, for AT command.
 
 bool Communication::SendDataESP8266(byte muxId, byte* buffer, byte length)
 {
 #if defined(DEBUG_ESP8266)
-  String message = String(millis()) + "ms: ESP send data: ";
+  String message = String(millis()) + "ms: ESP queue data: ";
   for (byte i = 0; i < length; i++)
     message += String(buffer[i]) + ", ";
   Serial.println(message);
 #endif
 
-  SendCommandESP8266("AT+CIPSEND=" + String(muxId) + "," + String(length));  // Request send data.
-  if (!ReceiveCommandESP8266(">"))  // Didn't get ready to send data.
-  {
-#if defined(DEBUG_ESP8266)
-    Serial.println(String(millis()) + "ms: ESP send data: Failed: Didn't receive: >\n");
-#endif
+  byte messages = outMessageTail - outMessageHead;
+  byte bufferUsed = outBufferTail - outBufferHead;
+  if (length == 0 || messages >= outMessageCount || length > outBufferSize - 1 - bufferUsed)
     return false;
-  }
 
-  esp8266Serial.write(buffer, length);  // Send data.
+  OutMessage &message = outMessages[outMessageTail % outMessageCount];
+  message.linkId = muxId;
+  message.length = length;
+  for (byte i = 0; i < length; i++)
+    outBuffer[outBufferTail++] = buffer[i];
+  outMessageTail++;
+
+  UpdateTransmitESP8266();
+  return true;
+}
 
-  if (!ReceiveCommandESP8266("SEND OK"))  // Send failed.
+void Communication::UpdateTransmitESP8266()
+{
+  if (transmitState == TransmitIdle)
   {
+    if (outMessageHead == outMessageTail)
+      return;
+
+    byte linkId = outMessages[outMessageHead % outMessageCount].linkId;
+    transmitLeft = 0;
+    while (outMessageHead != outMessageTail && outMessages[outMessageHead % outMessageCount].linkId == linkId)
+      transmitLeft += outMessages[outMessageHead++ % outMessageCount].length;
+
+    esp8266Serial.print("AT+CIPSEND=");  // Request send data.
+    esp8266Serial.print(linkId);
+    esp8266Serial.print(',');
+    esp8266Serial.println(transmitLeft);
 #if defined(DEBUG_ESP8266)
-    Serial.println(String(millis()) + "ms: ESP send data: Failed: Didn't receive: SEND OK\n");
+    Serial.println(String(millis()) + "ms: ESP send command: AT+CIPSEND=" + String(linkId) + "," + String(transmitLeft));
 #endif
-    return false;
+    transmitState = WaitPrompt;
+    transmitMillis = millis();
   }
+  else if (transmitState == TransmitData)
+  {
+    // Only what fits in the transmit buffer, the rest on the next update
+    int room = esp8266Serial.availableForWrite();
+    for (; transmitLeft > 0 && room > 0; transmitLeft--, room--)
+      esp8266Serial.write(outBuffer[outBufferHead++]);
 
+    if (transmitLeft == 0)
+    {
+      transmitState = WaitSendOk;
+      transmitMillis = millis();
+    }
+  }
+  else if (millis() - transmitMillis > transmitTimeout)
+  {
 #if defined(DEBUG_ESP8266)
-  Serial.println(String(millis()) + "ms: ESP send data: Success\n");
+    Serial.println(String(millis()) + "ms: ESP send data: Failed: Timeout\n");
 #endif
-  return true;
+    DropTransmitESP8266();
+  }
 }
 
-bool Communication::ReceiveDataESP8266(byte* muxId, byte* buffer, byte* length)
+void Communication::HandleReplyESP8266(IpdParser::Result reply)
 {
-  String command;
-
-  while (esp8266Serial.available())  // Only receive one line of message at a time. To avoid receiving messages that do not belong to this command.
+  if (reply == IpdParser::Prompt && transmitState == WaitPrompt)
   {
-    byte inByte = esp8266Serial.read();
-    command += (char)inByte;
-
-    if (command.indexOf("+IPD") != -1)  // Data command. Data is byte type, can't read as char type.
-    {
-      if (inByte == Orders::transEnd)
-      {
-        command += (char)esp8266Serial.read();  // Read \r.
-        command += (char)esp8266Serial.read();  // Read \n.
-        break;
-      }
-    }
-    else  // Not data command.
-    {
-      if (inByte == '\n')
-        break;
-    }
+    transmitState = TransmitData;
+    UpdateTransmitESP8266();
   }
-
+  else if (reply == IpdParser::SendOk && transmitState == WaitSendOk)
+  {
 #if defined(DEBUG_ESP8266)
-  if (command.length() > 0)
-    Serial.println(String(millis()) + "ms: ESP receive command: " + command);
+    Serial.println(String(millis()) + "ms: ESP send data: Success\n");
 #endif
-
-  if (command.indexOf("+IPD") != -1)  // Received data.
+    transmitState = TransmitIdle;
+    UpdateTransmitESP8266();
+  }
+  else if (reply == IpdParser::Error && transmitState != TransmitIdle)
   {
-    *muxId = (byte)command.charAt(command.indexOf(",") + 1) - '0';
-
-    byte indexStart = command.indexOf(":") + 1;
-    *length = command.length() - indexStart - 2;
-
-    for (byte i = 0; i < *length; i++)
-      buffer[i] = (byte)command.charAt(indexStart + i);
-
 #if defined(DEBUG_ESP8266)
-    String message = String(millis()) + "ms: ESP receive data: ";
-    message += "muxId: " + String(*muxId) + "; length: " + String(*length) + "; Data: ";
-    for (byte i = 0; i < *length; i++)
-      message += String(buffer[i]) + ", ";
-    Serial.println(message);
+    Serial.println(String(millis()) + "ms: ESP send data: Failed: Error\n");
 #endif
-    return true;
+    DropTransmitESP8266();
   }
+}
 
-  return false;
+void Communication::DropTransmitESP8266()
+{
+  // Data not written yet is skipped, what the module took is lost with it
+  outBufferHead += transmitLeft;
+  transmitLeft = 0;
+  transmitState = TransmitIdle;
 }
 
 void Communication::SendCommandESP8266(String command)
@@ -263,27 +376,44 @@ void Communication::UpdateESP8266()
   if (!isESP8266Available)
     return;
 
-  if (ReceiveDataESP8266(&esp8266ClientID, esp8266InData, &esp8266InDataCounter))  // Received order.
+  // Data of one +IPD may arrive over several updates, frames may span several +IPD.
+  while (esp8266Serial.available())
   {
-    if (esp8266InData[0] == Orders::transStart && esp8266InData[esp8266InDataCounter - 1] == Orders::transEnd)  // The order is complete.
+    byte inByte = esp8266Serial.read();
+    IpdParser::Result result = esp8266Parser.Parse(inByte);
+    if (result == IpdParser::Data)
+    {
+      esp8266ClientID = esp8266Parser.GetLinkId();
+#if defined(DEBUG_ESP8266)
+      Serial.println(String(millis()) + "ms: ESP receive data: muxId: " + String(esp8266ClientID) + "; Data: " + String(inByte));
+#endif
+      ReceiveByte(esp8266InFrame, inByte, OrderSource::FromESP8266);
+    }
+    else if (result != IpdParser::None)
     {
-      HandleOrder(esp8266InData, OrderSource::FromESP8266);
-      esp8266InDataCounter = 0;
+      HandleReplyESP8266(result);
     }
   }
+
+  UpdateTransmitESP8266();
 }
 
 void Communication::HandleOrder(byte inData[], OrderSource orderSource)
 {
-  if (blockedOrder != 0)
+  // Setpoints are taken while a blocking order runs too, the latest one is followed afterwards
+  if (inData[1] == Orders::requestStreamBodyPose)
+  {
+    HandleStreamBodyPose(inData);
     return;
+  }
 
-  this->orderSource = orderSource;
+  // Legacy clients wait for orderDone, orders sent meanwhile are dropped
+  if (IsOrderBusy())
+    return;
 
   byte outData[outDataSize];
   byte outDataCounter = 0;
-
-  outData[outDataCounter++] = Orders::transStart;
+  BlockedOrder blocked = {};
 
   if (inData[1] == Orders::requestEcho)
   {
@@ -296,6 +426,15 @@ void Communication::HandleOrder(byte inData[], OrderSource orderSource)
     outData[outDataCounter++] = (int)(supplyVoltage * 100) / 128;
     outData[outDataCounter++] = (int)(supplyVoltage * 100) % 128;
   }
+  else if (inData[1] == Orders::requestJointHeat)
+  {
+    outData[outDataCounter++] = Orders::jointHeat;
+    for (int leg = 1; leg <= 6; leg++)
+    {
+      for (int joint = 0; joint < 3; joint++)
+        outData[outDataCounter++] = min(127, (int)(robotAction.robot.GetJointHeat(leg, joint) * 100));
+    }
+  }
   else if (inData[1] == Orders::requestChangeIO)
   {
     digitalWrite(pins[inData[2]], inData[3]);
@@ -315,72 +454,326 @@ void Communication::HandleOrder(byte inData[], OrderSource orderSource)
   {
     // Motor testing - directly set servo angle (bypasses limits)
     // inData[2] = leg (1-6), inData[3] = joint (0-2), inData[4] = angle (0-180)
-    robotAction.robot.SetServoAngle(inData[2], inData[3], inData[4]);
-    outData[outDataCounter++] = Orders::orderDone;
+    bool isSet = robotAction.robot.SetServoAngle(inData[2], inData[3], inData[4]);
+    outData[outDataCounter++] = isSet ? Orders::orderDone : Orders::orderRejected;
   }
   else if (inData[1] >= 64 && inData[1] <= 108)
   {
-    blockedOrder = inData[1];
+    blocked.order = inData[1];
     outData[outDataCounter++] = Orders::orderStart;
   }
   else if (inData[1] == Orders::requestCrawl)
   {
-    blockedOrder = inData[1];
-    crawlParameters[0] = inData[2];
-    crawlParameters[1] = inData[3];
-    crawlParameters[2] = inData[4];
+    blocked.order = inData[1];
+    blocked.parameters[0] = inData[2] - 64;
+    blocked.parameters[1] = inData[3] - 64;
+    blocked.parameters[2] = inData[4] - 64;
+    outData[outDataCounter++] = Orders::orderStart;
+  }
+  else if (inData[1] == Orders::requestCrawlArc)
+  {
+    blocked.order = inData[1];
+    blocked.parameters[0] = (inData[2] - 64) * 10;
+    blocked.parameters[1] = (inData[3] - 64) * 10;
+    blocked.parameters[2] = inData[4] - 64;
     outData[outDataCounter++] = Orders::orderStart;
   }
   else if (inData[1] == Orders::requestChangeBodyHeight)
   {
-    blockedOrder = inData[1];
-    changeHeightParameters[0] = inData[2];
+    blocked.order = inData[1];
+    blocked.parameters[0] = inData[2] - 64;
     outData[outDataCounter++] = Orders::orderStart;
   }
   else if (inData[1] == Orders::requestMoveBody)
   {
-    blockedOrder = inData[1];
-    moveBodyParameters[0] = inData[2];
-    moveBodyParameters[1] = inData[3];
-    moveBodyParameters[2] = inData[4];
+    blocked.order = inData[1];
+    blocked.parameters[0] = inData[2] - 64;
+    blocked.parameters[1] = inData[3] - 64;
+    blocked.parameters[2] = inData[4] - 64;
     outData[outDataCounter++] = Orders::orderStart;
   }
   else if (inData[1] == Orders::requestRotateBody)
   {
-    blockedOrder = inData[1];
-    rotateBodyParameters[0] = inData[2];
-    rotateBodyParameters[1] = inData[3];
-    rotateBodyParameters[2] = inData[4];
+    blocked.order = inData[1];
+    blocked.parameters[0] = inData[2] - 64;
+    blocked.parameters[1] = inData[3] - 64;
+    blocked.parameters[2] = inData[4] - 64;
     outData[outDataCounter++] = Orders::orderStart;
   }
   else if (inData[1] == Orders::requestTwistBody)
   {
-    blockedOrder = inData[1];
-    twistBodyParameters[0] = inData[2];
-    twistBodyParameters[1] = inData[3];
-    twistBodyParameters[2] = inData[4];
-    twistBodyParameters[3] = inData[5];
-    twistBodyParameters[4] = inData[6];
-    twistBodyParameters[5] = inData[7];
+    blocked.order = inData[1];
+    for (byte i = 0; i < 6; i++)
+      blocked.parameters[i] = inData[2 + i] - 64;
     outData[outDataCounter++] = Orders::orderStart;
   }
-  outData[outDataCounter++] = Orders::transEnd;
 
-  if (orderSource == OrderSource::FromSerial)
-    Serial.write(outData, outDataCounter);
-  else if (orderSource == OrderSource::FromESP8266)
-    SendDataESP8266(esp8266ClientID, outData, outDataCounter);
+  if (blocked.order != 0)
+  {
+    blocked.source = orderSource;
+    blocked.linkId = esp8266ClientID;
+    blocked.protocol = Protocol::Legacy;
+    AddBlockedOrder(blocked);
+  }
+  SendOrder(outData, outDataCounter, orderSource, esp8266ClientID, Protocol::Legacy, 0);
 }
 
-void Communication::UpdateBlockedOrder()
+float Communication::GetValueV2(const byte data[], byte index)
+{
+  return (int16_t)(data[index * 2] | ((uint16_t)data[index * 2 + 1] << 8)) / 10.0;
+}
+
+void Communication::AddValueV2(byte data[], byte &counter, float value)
+{
+  int16_t tenths = constrain(value * 10, -32768.0, 32767.0);
+  data[counter++] = tenths & 0xFF;
+  data[counter++] = (uint16_t)tenths >> 8;
+}
+
+void Communication::AddUnsignedV2(byte data[], byte &counter, unsigned long value)
+{
+  value = min(value, 65535UL);
+  data[counter++] = value & 0xFF;
+  data[counter++] = value >> 8;
+}
+
+void Communication::HandleOrderV2(byte packet[], byte length, OrderSource orderSource)
 {
-  byte blockedOrder = this->blockedOrder;
-  if (blockedOrder == 0)
+  byte sequence = packet[0];
+  byte order = packet[1];
+  byte *inData = packet + 2;
+  byte inDataLength = length - 2;
+
+  if (order == Orders::requestStreamBodyPose)
+  {
+    if (inDataLength >= 12)
+      HandleStreamBodyPoseV2(sequence, inData);
     return;
+  }
+
+  byte outData[outDataSize];
+  byte outDataCounter = 0;
+  BlockedOrder blocked = {};
+
+  if (order == Orders::requestEcho)
+  {
+    outData[outDataCounter++] = Orders::echo;
+  }
+  else if (order == Orders::requestSupplyVoltage)
+  {
+    outData[outDataCounter++] = Orders::supplyVoltage;
+    AddUnsignedV2(outData, outDataCounter, GetSupplyVoltage() * 1000);
+  }
+  else if (order == Orders::requestJointHeat)
+  {
+    outData[outDataCounter++] = Orders::jointHeat;
+    for (int leg = 1; leg <= 6; leg++)
+    {
+      for (int joint = 0; joint < 3; joint++)
+        outData[outDataCounter++] = min(255, (int)(robotAction.robot.GetJointHeat(leg, joint) * 100));
+    }
+  }
+  else if (order == Orders::requestClearOrders)
+  {
+    ClearBlockedOrders();
+    outData[outDataCounter++] = Orders::orderDone;
+  }
+  else if (order == Orders::requestTelemetry && inDataLength >= 2)
+  {
+    telemetryPeriod = inData[0];
+    telemetryFields = inData[1];
+    telemetryCounter = 0;
+    telemetrySource = orderSource;
+    telemetryLinkId = esp8266ClientID;
+    outData[outDataCounter++] = Orders::orderDone;
+  }
+  // Orders that move the servos wait for the blocking orders
+  else if (IsOrderBusy() && (order == Orders::requestMoveLeg || order == Orders::requestCalibrate || order == Orders::requestSetServoAngle))
+  {
+    outData[outDataCounter++] = Orders::orderRejected;
+  }
+  else if (order == Orders::requestChangeIO && inDataLength >= 2 && inData[0] < 8)
+  {
+    digitalWrite(pins[inData[0]], inData[1]);
+    outData[outDataCounter++] = Orders::orderDone;
+  }
+  else if (order == Orders::requestMoveLeg && inDataLength >= 7)
+  {
+    robotAction.LegMoveToRelativelyDirectly(inData[0], Point(GetValueV2(inData + 1, 0), GetValueV2(inData + 1, 1), GetValueV2(inData + 1, 2)));
+    outData[outDataCounter++] = Orders::orderDone;
+  }
+  else if (order == Orders::requestCalibrate)
+  {
+    robotAction.robot.CalibrateServos();
+    outData[outDataCounter++] = Orders::orderDone;
+  }
+  else if (order == Orders::requestSetServoAngle && inDataLength >= 3)
+  {
+    bool isSet = robotAction.robot.SetServoAngle(inData[0], inData[1], inData[2]);
+    outData[outDataCounter++] = isSet ? Orders::orderDone : Orders::orderRejected;
+  }
+  else if (order >= 64 && order <= 108)
+  {
+    blocked.order = order;
+  }
+  else if (order == Orders::requestCrawl && inDataLength >= 6)
+  {
+    blocked.order = order;
+    for (byte i = 0; i < 3; i++)
+      blocked.parameters[i] = GetValueV2(inData, i);
+  }
+  else if (order == Orders::requestCrawlArc && inDataLength >= 6)
+  {
+    blocked.order = order;
+    for (byte i = 0; i < 3; i++)
+      blocked.parameters[i] = GetValueV2(inData, i);
+  }
+  else if (order == Orders::requestChangeBodyHeight && inDataLength >= 2)
+  {
+    blocked.order = order;
+    blocked.parameters[0] = GetValueV2(inData, 0);
+  }
+  else if (order == Orders::requestMoveBody && inDataLength >= 6)
+  {
+    blocked.order = order;
+    for (byte i = 0; i < 3; i++)
+      blocked.parameters[i] = GetValueV2(inData, i);
+  }
+  else if (order == Orders::requestRotateBody && inDataLength >= 6)
+  {
+    blocked.order = order;
+    for (byte i = 0; i < 3; i++)
+      blocked.parameters[i] = GetValueV2(inData, i);
+  }
+  else if (order == Orders::requestTwistBody && inDataLength >= 12)
+  {
+    blocked.order = order;
+    for (byte i = 0; i < 6; i++)
+      blocked.parameters[i] = GetValueV2(inData, i);
+  }
+
+  if (blocked.order != 0)
+  {
+    blocked.source = orderSource;
+    blocked.linkId = esp8266ClientID;
+    blocked.protocol = Protocol::V2;
+    blocked.sequence = sequence;
+    if (AddBlockedOrder(blocked))
+    {
+      outData[outDataCounter++] = Orders::orderStart;
+      outData[outDataCounter++] = GetFreeOrderSlots();
+    }
+    else
+    {
+      outData[outDataCounter++] = Orders::orderRejected;
+    }
+  }
+
+  // Unknown or short orders are not responded
+  if (outDataCounter == 0)
+    return;
+
+  SendOrder(outData, outDataCounter, orderSource, esp8266ClientID, Protocol::V2, sequence);
+}
+
+void Communication::HandleStreamBodyPose(byte inData[])
+{
+  // The difference of the sequences is 1~63 for a newer setpoint, wrapping at 128
+  byte sequence = inData[2];
+  byte difference = (sequence - streamPoseSequence) & 0x7F;
+  if (robotAction.IsBodyPoseStreaming() && (difference == 0 || difference > 63))
+    return;
+  streamPoseSequence = sequence;
+
+  float pose[6];
+  for (byte i = 0; i < 6; i++)
+    pose[i] = inData[3 + i] - 64;
+  StreamBodyPose(pose);
+}
+
+void Communication::HandleStreamBodyPoseV2(byte sequence, byte inData[])
+{
+  // The difference of the sequences is 1~127 for a newer setpoint, wrapping at 256
+  byte difference = sequence - streamPoseSequence;
+  if (robotAction.IsBodyPoseStreaming() && (difference == 0 || difference > 127))
+    return;
+  streamPoseSequence = sequence;
+
+  float pose[6];
+  for (byte i = 0; i < 6; i++)
+    pose[i] = GetValueV2(inData, i);
+  StreamBodyPose(pose);
+}
+
+void Communication::StreamBodyPose(const float pose[6])
+{
+  float angle = sqrt(pow(pose[3], 2) + pow(pose[4], 2) + pow(pose[5], 2));
+  robotAction.StreamBodyPose(BodyPose(pose[0], pose[1], pose[2], Quaternion::FromAxisAngle(pose[3], pose[4], pose[5], angle)));
 
   lastBlockedOrderTime = millis();
+}
+
+void Communication::StartBodyPoseStream()
+{
+  if (!robotAction.IsBodyPoseStreaming() || robotAction.IsBodyPoseStreamReady())
+    return;
+
+  isOrderExecuting = true;
+  SaveRobotBootState(Robot::State::Boot);
+  robotAction.StartBodyPoseStream();
+  isOrderExecuting = false;
+}
+
+void Communication::UpdateBodyPoseStream()
+{
+  // In the loop, between the blocking orders, so the stream and the actions do not move the legs at once
+  robotAction.UpdateBodyPoseStream();
+}
+
+bool Communication::AddBlockedOrder(const BlockedOrder &order)
+{
+  if (GetFreeOrderSlots() == 0)
+    return false;
+  orderQueue[orderQueueTail % orderQueueSize] = order;
+  orderQueueTail++;
+  return true;
+}
 
-  orderState = OrderState::ExecuteStart;
+void Communication::ClearBlockedOrders()
+{
+  // The order that runs is out of the queue already and still responds orderDone
+  noInterrupts();
+  orderQueueTail = orderQueueHead;
+  interrupts();
+}
+
+byte Communication::GetFreeOrderSlots()
+{
+  return orderQueueSize - (byte)(orderQueueTail - orderQueueHead);
+}
+
+bool Communication::IsOrderBusy()
+{
+  return isOrderExecuting || orderQueueTail != orderQueueHead;
+}
+
+void Communication::UpdateBlockedOrder()
+{
+  // Orders are added by the communication in the timer interrupt
+  noInterrupts();
+  if (orderQueueHead == orderQueueTail)
+  {
+    interrupts();
+    return;
+  }
+  BlockedOrder blocked = orderQueue[orderQueueHead % orderQueueSize];
+  orderQueueHead++;
+  isOrderExecuting = true;
+  interrupts();
+
+  byte blockedOrder = blocked.order;
+  const float *parameters = blocked.parameters;
+  lastBlockedOrderTime = millis();
 
   if (blockedOrder == Orders::requestCrawlForward)
   {
@@ -449,67 +842,109 @@ void Communication::UpdateBlockedOrder()
   else if (blockedOrder == Orders::requestCrawl)
   {
     SaveRobotBootState(Robot::State::Boot);
-    float x = crawlParameters[0] - 64;
-    float y = crawlParameters[1] - 64;
-    float angle = crawlParameters[2] - 64;
-    robotAction.Crawl(x, y, angle);
+    robotAction.Crawl(parameters[0], parameters[1], parameters[2]);
+  }
+  else if (blockedOrder == Orders::requestCrawlArc)
+  {
+    SaveRobotBootState(Robot::State::Boot);
+    robotAction.CrawlArc(parameters[0], parameters[1], parameters[2]);
   }
   else if (blockedOrder == Orders::requestChangeBodyHeight)
   {
     SaveRobotBootState(Robot::State::Boot);
-    float height = changeHeightParameters[0] - 64;
-    robotAction.ChangeBodyHeight(height);
+    robotAction.ChangeBodyHeight(parameters[0]);
   }
   else if (blockedOrder == Orders::requestMoveBody)
   {
     SaveRobotBootState(Robot::State::Boot);
-    float x = moveBodyParameters[0] - 64;
-    float y = moveBodyParameters[1] - 64;
-    float z = moveBodyParameters[2] - 64;
-    robotAction.MoveBody(x, y, z);
+    robotAction.MoveBody(parameters[0], parameters[1], parameters[2]);
   }
   else if (blockedOrder == Orders::requestRotateBody)
   {
     SaveRobotBootState(Robot::State::Boot);
-    float x = rotateBodyParameters[0] - 64;
-    float y = rotateBodyParameters[1] - 64;
-    float z = rotateBodyParameters[2] - 64;
-    robotAction.RotateBody(x, y, z);
+    robotAction.RotateBody(parameters[0], parameters[1], parameters[2]);
   }
   else if (blockedOrder == Orders::requestTwistBody)
   {
     SaveRobotBootState(Robot::State::Boot);
-    float xMove = twistBodyParameters[0] - 64;
-    float yMove = twistBodyParameters[1] - 64;
-    float zMove = twistBodyParameters[2] - 64;
-    float xRotate = twistBodyParameters[3] - 64;
-    float yRotate = twistBodyParameters[4] - 64;
-    float zRotate = twistBodyParameters[5] - 64;
-    robotAction.TwistBody(Point(xMove, yMove, zMove), Point(xRotate, yRotate, zRotate));
+    robotAction.TwistBody(Point(parameters[0], parameters[1], parameters[2]),
+                          Point(parameters[3], parameters[4], parameters[5]));
   }
 
-  this->blockedOrder = 0;
-  orderState = OrderState::ExecuteDone;
+  // orderDone is sent by CheckBlockedOrder(), which empties the queue every control tick
+  while ((byte)(doneQueueTail - doneQueueHead) >= orderQueueSize)
+    ;
+  DoneOrder &done = doneQueue[doneQueueTail % orderQueueSize];
+  done.source = blocked.source;
+  done.linkId = blocked.linkId;
+  done.protocol = blocked.protocol;
+  done.sequence = blocked.sequence;
+  noInterrupts();
+  doneQueueTail++;
+  isOrderExecuting = false;
+  interrupts();
 }
 
 void Communication::CheckBlockedOrder()
 {
-  if (orderState != OrderState::ExecuteDone)
-    return;
+  while (doneQueueHead != doneQueueTail)
+  {
+    DoneOrder &done = doneQueue[doneQueueHead % orderQueueSize];
+    byte outData[] = { Orders::orderDone };
+    SendOrder(outData, 1, done.source, done.linkId, done.protocol, done.sequence);
+    doneQueueHead++;
+  }
+}
 
-  byte outData[outDataSize];
-  byte outDataCounter = 0;
+void Communication::UpdateTelemetry()
+{
+  if (telemetryPeriod == 0 || ++telemetryCounter < telemetryPeriod)
+    return;
+  telemetryCounter = 0;
 
-  outData[outDataCounter++] = Orders::transStart;
-  outData[outDataCounter++] = Orders::orderDone;
-  outData[outDataCounter++] = Orders::transEnd;
+  byte data[maxPacketSize];
+  byte counter = 0;
+  data[counter++] = Orders::telemetry;
+  data[counter++] = telemetryFields;
 
-  if (orderSource == OrderSource::FromSerial)
-    Serial.write(outData, outDataCounter);
-  else if (orderSource == OrderSource::FromESP8266)
-    SendDataESP8266(esp8266ClientID, outData, outDataCounter);
+  if (telemetryFields & Orders::telemetryJoints)
+  {
+    for (int leg = 1; leg <= 6; leg++)
+    {
+      for (int joint = 0; joint < 3; joint++)
+        AddValueV2(data, counter, robotAction.robot.GetJoint(leg, joint)->jointAngleNow);
+    }
+  }
+  if (telemetryFields & Orders::telemetryFeet)
+  {
+    RobotLegsPoints points;
+    robotAction.robot.GetPointsNow(points);
+    Point *feet[6] = { &points.leg1, &points.leg2, &points.leg3, &points.leg4, &points.leg5, &points.leg6 };
+    for (byte i = 0; i < 6; i++)
+    {
+      AddValueV2(data, counter, feet[i]->x);
+      AddValueV2(data, counter, feet[i]->y);
+      AddValueV2(data, counter, feet[i]->z);
+    }
+  }
+  if (telemetryFields & Orders::telemetryVoltage)
+  {
+    AddUnsignedV2(data, counter, GetSupplyVoltage() * 1000);
+  }
+  if (telemetryFields & Orders::telemetryTiming)
+  {
+    Robot::LoopTiming timing = robotAction.robot.GetLoopTiming(true);
+    AddUnsignedV2(data, counter, timing.periodMicros);
+    AddUnsignedV2(data, counter, timing.updateMicros);
+    AddUnsignedV2(data, counter, timing.maxUpdateMicros);
+  }
+  if (telemetryFields & Orders::telemetryQueue)
+  {
+    data[counter++] = orderQueueTail - orderQueueHead;
+    data[counter++] = isOrderExecuting ? 1 : 0;
+  }
 
-  orderState = OrderState::ExecuteNone;
+  SendOrder(data, counter, telemetrySource, telemetryLinkId, Protocol::V2, telemetrySequence++);
 }
 
 void Communication::UpdateAutoSleep()
@@ -519,7 +954,11 @@ void Communication::UpdateAutoSleep()
     if (millis() - lastBlockedOrderTime > autoSleepOvertime)
     {
       if (robotAction.robot.state == Robot::State::Action)
+      {
+        isOrderExecuting = true;
         robotAction.SleepMode();
+        isOrderExecuting = false;
+      }
       lastBlockedOrderTime = 0;
     }
   }
@@ -534,12 +973,15 @@ void Communication::UpdateCommunication()
     UpdateSerial();
     UpdateESP8266();
     CheckBlockedOrder();
+    UpdateTelemetry();
   }
 }
 
 void Communication::UpdateOrder()
 {
   UpdateBlockedOrder();
+  StartBodyPoseStream();
+  UpdateBodyPoseStream();
   UpdateAutoSleep();
 }
 
@@ -626,7 +1068,19 @@ void UpdateService()
   sei();
 
   if (communication != NULL) {
-    communication->robotAction.robot.Update();
+    // While the servos are detached the robot is updated only every few ticks, the links are
+    // still read every tick as their receive buffers fill in a few milliseconds
+    static byte lowPowerTickCounter = 0;
+    bool isRobotTick = true;
+    if (communication->robotAction.robot.IsLowPower())
+    {
+      isRobotTick = ++lowPowerTickCounter >= Robot::lowPowerTickDivider;
+      if (isRobotTick)
+        lowPowerTickCounter = 0;
+    }
+
+    if (isRobotTick)
+      communication->robotAction.robot.Update();
     communication->UpdateCommunication();
   }
 }
@@ -11,6 +11,8 @@
 
 #include "ProjectDamsonBasic.h"
 #include "ProjectDamsonOrders.h"
+#include "ProjectDamsonFrame.h"
+#include "ProjectDamsonIpd.h"
 
 class Communication
 {
@@ -39,12 +41,36 @@ private:
 
   static const int inDataSize = 32;
   static const int outDataSize = 32;
+  // v2 packets sent, the largest is telemetry with every field
+  static const int maxPacketSize = 96;
 
-  byte serialInData[inDataSize];
-  byte serialInDataCounter = 0;
+  enum OrderSource { FromSerial, FromESP8266, FromNone };
+  enum Protocol { Legacy, V2 };
+
+  // Bytes of each link are collected into a legacy or a v2 frame, by the byte that starts it
+  enum FrameState { FrameNone, FrameLegacy, FrameV2 };
+  struct InFrame
+  {
+    byte data[inDataSize];
+    byte counter;
+    FrameState state;
+  };
+  void ReceiveByte(InFrame &frame, byte inByte, OrderSource orderSource);
+  void ReceiveFrame(byte frame[], byte length, OrderSource orderSource);
+
+  InFrame serialInFrame = {};
   void StartSerial();
   void UpdateSerial();
 
+  // Frames to the serial port wait here, UpdateSerial() writes what fits in the transmit buffer of
+  // Serial so the control tick never waits for it. A frame that does not fit is dropped.
+  static const unsigned int serialOutBufferSize = 128;       // Power of 2, indexed by byte
+  byte serialOutBuffer[serialOutBufferSize];
+  byte serialOutHead = 0;
+  byte serialOutTail = 0;
+  bool SendDataSerial(byte* buffer, byte length);
+  void UpdateTransmitSerial();
+
   String esp8266SSID = "Damson";
   String esp8266PWD = "Freenove";
   byte esp8266CHL = 1;
@@ -52,31 +78,97 @@ private:
   HardwareSerial& esp8266Serial = Serial2;
   unsigned long esp8266Baud = 115200;
   bool isESP8266Available = false;
-  byte esp8266ClientID;
-  byte esp8266InData[inDataSize];
-  byte esp8266InDataCounter = 0;
+  byte esp8266ClientID;                                      // Link of the data being received
+  IpdParser esp8266Parser;
+  InFrame esp8266InFrame = {};
   void SendCommandESP8266(String command);
   bool ReceiveCommandESP8266(String flag, unsigned long timeOut = 100, unsigned long timeWait = 0);
   bool SendDataESP8266(byte muxId, byte* buffer, byte length);
-  bool ReceiveDataESP8266(byte* muxId, byte* buffer, byte* length);
   void StartESP8266();
   void UpdateESP8266();
 
-  enum OrderSource { FromSerial, FromESP8266, FromNone };
-  OrderSource orderSource = OrderSource::FromNone;
-
-  enum OrderState { ExecuteStart, ExecuteDone, ExecuteNone };
-  OrderState orderState = OrderState::ExecuteNone;
-
-  volatile byte blockedOrder = 0;
-
-  byte crawlParameters[3];
-  byte changeHeightParameters[1];
-  byte moveBodyParameters[3];
-  byte rotateBodyParameters[3];
-  byte twistBodyParameters[6];
+  // Data to send waits in a queue, the AT+CIPSEND exchange is advanced by UpdateESP8266() and the
+  // replies parsed from the received bytes, so nothing waits for the module. Queued data of the
+  // same link goes out in one AT+CIPSEND. Data that does not fit, fails or times out is dropped.
+  struct OutMessage
+  {
+    byte linkId;
+    byte length;
+  };
+  static const byte outMessageCount = 8;                     // Power of 2
+  static const unsigned int outBufferSize = 256;             // Indexed by byte
+  static const unsigned long transmitTimeout = 300;          // For each reply (ms)
+  enum TransmitState : byte { TransmitIdle, WaitPrompt, TransmitData, WaitSendOk };
+  OutMessage outMessages[outMessageCount];
+  byte outMessageHead = 0;
+  byte outMessageTail = 0;
+  byte outBuffer[outBufferSize];
+  byte outBufferHead = 0;
+  byte outBufferTail = 0;
+  TransmitState transmitState = TransmitIdle;
+  unsigned int transmitLeft = 0;                             // Bytes of the send still to write
+  unsigned long transmitMillis = 0;
+  void UpdateTransmitESP8266();
+  void HandleReplyESP8266(IpdParser::Result reply);
+  void DropTransmitESP8266();
+
+  // Blocking orders are queued by the communication and run one after another by UpdateOrder().
+  // Each remembers where its orderDone goes, with the sequence of a v2 order as its ID.
+  struct BlockedOrder
+  {
+    byte order;
+    OrderSource source;
+    byte linkId;                                             // ESP8266 link of the order
+    Protocol protocol;
+    byte sequence;
+    float parameters[6];
+  };
+  struct DoneOrder
+  {
+    OrderSource source;
+    byte linkId;
+    Protocol protocol;
+    byte sequence;
+  };
+
+  // Both queues count their head and tail up to 255 and wrap, the size must divide 256
+  static const byte orderQueueSize = 8;
+  BlockedOrder orderQueue[orderQueueSize];
+  volatile byte orderQueueHead = 0;
+  volatile byte orderQueueTail = 0;
+  DoneOrder doneQueue[orderQueueSize];
+  volatile byte doneQueueHead = 0;
+  volatile byte doneQueueTail = 0;
+
+  bool AddBlockedOrder(const BlockedOrder &order);
+  void ClearBlockedOrders();
+  byte GetFreeOrderSlots();
+  bool IsOrderBusy();
+
+  volatile bool isOrderExecuting = false;
+
+  byte streamPoseSequence = 0;
+  void HandleStreamBodyPose(byte data[]);
+  void HandleStreamBodyPoseV2(byte sequence, byte data[]);
+  void StreamBodyPose(const float pose[6]);
+  void StartBodyPoseStream();
+  void UpdateBodyPoseStream();
 
   void HandleOrder(byte data[], OrderSource orderSource);
+  void HandleOrderV2(byte packet[], byte length, OrderSource orderSource);
+  static float GetValueV2(const byte data[], byte index);
+  static void AddValueV2(byte data[], byte &counter, float value);
+  static void AddUnsignedV2(byte data[], byte &counter, unsigned long value);
+
+  byte telemetryPeriod = 0;
+  byte telemetryFields = 0;
+  byte telemetryCounter = 0;
+  byte telemetrySequence = 0;
+  OrderSource telemetrySource = OrderSource::FromNone;
+  byte telemetryLinkId = 0;
+  void UpdateTelemetry();
+
+  void SendOrder(byte data[], byte length, OrderSource orderSource, byte linkId, Protocol protocol, byte sequence);
 
   void UpdateBlockedOrder();
 
@@ -0,0 +1,71 @@
+/*
+ * File       Gait energy meter for Project Damson
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include "ProjectDamsonEnergy.h"
+
+float EnergyMeter::GetServoCurrent(float degrees, float load, float seconds)
+{
+  if (seconds <= 0)
+    return idleCurrent;
+  return idleCurrent + loadCurrent * load + motionCharge * degrees / seconds;
+}
+
+void EnergyMeter::AddVoltage(float voltage)
+{
+  if (voltageSamples == 255)
+    return;
+  voltageSum += voltage;
+  voltageSamples++;
+}
+
+void EnergyMeter::Update(float current, float seconds)
+{
+  if (voltageSamples > 0)
+  {
+    lastVoltage = voltageSum / voltageSamples;
+    voltageSum = 0;
+    voltageSamples = 0;
+  }
+  joules += lastVoltage * current * seconds;
+}
+
+void EnergyMeter::AddStep(float distance, byte stepsPerCycle)
+{
+  this->distance += distance;
+  if (++steps < stepsPerCycle)
+    return;
+
+  unsigned long now = millis();
+  lastCycle.cycles = 1;
+  lastCycle.joules = joules;
+  lastCycle.distance = this->distance;
+  lastCycle.durationMs = now - cycleStartMillis;
+
+  total.cycles++;
+  total.joules += lastCycle.joules;
+  total.distance += lastCycle.distance;
+  total.durationMs += lastCycle.durationMs;
+
+  joules = 0;
+  this->distance = 0;
+  steps = 0;
+  cycleStartMillis = now;
+}
+
+void EnergyMeter::Reset()
+{
+  joules = 0;
+  distance = 0;
+  steps = 0;
+  cycleStartMillis = millis();
+  lastCycle = {};
+  total = {};
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * File       Gait energy meter for Project Damson
+ * Project    Project Damson
+ * Brief      Integrates the supply power over the gait, to compare the action groups by energy
+ *            per gait loop and per millimetre travelled. The supply voltage is sampled every
+ *            control tick. There is no current sensor, so the servo current is estimated from the
+ *            same commanded motion and holding load as JointThermal. Its constants are rough
+ *            figures for MG90S servos, good for comparing gaits rather than for absolute values.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include <Arduino.h>
+
+class EnergyMeter
+{
+public:
+  // Current of an enabled servo at rest (A)
+  static constexpr float idleCurrent = 0.01;
+  // Current per unit of holding load, share of body weight * lever in mm (A)
+  static constexpr float loadCurrent = 0.006;
+  // Charge per degree moved (A s), 0.24 A while sweeping 300 deg/s
+  static constexpr float motionCharge = 0.0008;
+
+  struct Report
+  {
+    unsigned int cycles;
+    float joules;
+    float distance;             // Body travel (mm)
+    unsigned long durationMs;
+
+    float GetJoulesPerCycle() const { return cycles > 0 ? joules / cycles : 0; }
+    float GetJoulesPerMm() const { return distance > 0 ? joules / distance : 0; }
+  };
+
+ /*
+  * Brief     Estimated current of one servo over an update
+  * Param     degrees   Commanded motion since the last update
+  *           load      Share of body weight times the lever (mm), 0 if the joint holds nothing
+  *           seconds   Time since the last update
+  * -----------------------------------------------------------------------------------------------*/
+  static float GetServoCurrent(float degrees, float load, float seconds);
+
+ /*
+  * Brief     Add a supply voltage sample, every control tick
+  * -----------------------------------------------------------------------------------------------*/
+  void AddVoltage(float voltage);
+
+ /*
+  * Brief     Add the energy of the total servo current at the mean voltage since the last update
+  * -----------------------------------------------------------------------------------------------*/
+  void Update(float current, float seconds);
+
+ /*
+  * Brief     Count one gait step, a loop is complete every stepsPerCycle steps
+  *           The energy of a loop includes any pause before it
+  * Param     distance  Body travel of the step (mm)
+  * -----------------------------------------------------------------------------------------------*/
+  void AddStep(float distance, byte stepsPerCycle);
+
+ /*
+  * Brief     Start counting loops again
+  * -----------------------------------------------------------------------------------------------*/
+  void Reset();
+
+  Report GetLastCycle() const { return lastCycle; }
+  Report GetTotal() const { return total; }
+
+private:
+  float voltageSum = 0;
+  byte voltageSamples = 0;
+  float lastVoltage = 0;
+
+  // Energy since the last complete loop
+  float joules = 0;
+  float distance = 0;
+  byte steps = 0;
+  unsigned long cycleStartMillis = 0;
+
+  Report lastCycle = {};
+  Report total = {};
+};
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * File       Footstep planner for Project Damson
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include "ProjectDamsonFootstep.h"
+
+FootstepPlan::FootstepPlan() {}
+
+bool FootstepPlan::AddSegment(Point move, Point centre, float angle, int steps)
+{
+  if (segmentCount >= maxSegments || steps < 1)
+    return false;
+
+  // Store the motion of a single step
+  Segment &segment = segments[segmentCount++];
+  segment.moveX = move.x / steps;
+  segment.moveY = move.y / steps;
+  segment.centreX = centre.x;
+  segment.centreY = centre.y;
+  segment.angle = angle / steps;
+  segment.steps = steps;
+  return true;
+}
+
+void FootstepPlan::RefineSegment(int segment)
+{
+  if (segment < 0 || segment >= segmentCount)
+    return;
+
+  segments[segment].moveX /= 2;
+  segments[segment].moveY /= 2;
+  segments[segment].angle /= 2;
+  segments[segment].steps *= 2;
+}
+
+int FootstepPlan::GetStepCount()
+{
+  int count = 0;
+  for (int i = 0; i < segmentCount; i++)
+    count += segments[i].steps;
+  return count;
+}
+
+int FootstepPlan::GetSegment(int step)
+{
+  if (step < 0)
+    return -1;
+
+  for (int i = 0; i < segmentCount; i++)
+  {
+    if (step < segments[i].steps)
+      return i;
+    step -= segments[i].steps;
+  }
+  return -1;
+}
+
+bool FootstepPlan::GetStep(int step, Point &move, Point &centre, float &angle)
+{
+  int segment = GetSegment(step);
+  if (segment < 0)
+  {
+    move = Point(0, 0, 0);
+    centre = Point(0, 0, 0);
+    angle = 0;
+    return false;
+  }
+
+  move = Point(segments[segment].moveX, segments[segment].moveY, 0);
+  centre = Point(segments[segment].centreX, segments[segment].centreY, 0);
+  angle = segments[segment].angle;
+  return true;
+}
+
+#endif
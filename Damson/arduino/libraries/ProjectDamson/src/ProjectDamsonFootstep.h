@@ -0,0 +1,68 @@
+/*
+ * File       Footstep planner for Project Damson
+ * Project    Project Damson
+ * Brief      A short path of body poses split into crawl steps.
+ *            RobotAction::CrawlPath() plans every foothold along the path before the first leg is
+ *            lifted, so each swing leg lands where the coming steps need it.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include "ProjectDamsonBasic.h"
+
+// Body pose relative to the pose when the path starts, same units and directions as Crawl()
+struct PathPose
+{
+  float x;
+  float y;
+  float angle;
+};
+
+class FootstepPlan
+{
+public:
+  FootstepPlan();
+
+  static const int maxSegments = 8;
+
+ /*
+  * Brief     Append a path segment walked in a number of equal crawl steps
+  * Param     move      Body move of the whole segment, used when angle is 0
+  *           centre    Turn centre of the segment relative to the body
+  *           angle     Angle turned around the centre over the whole segment
+  *           steps     Crawl steps used to walk the segment
+  * Retval    false if the plan is full
+  * -----------------------------------------------------------------------------------------------*/
+  bool AddSegment(Point move, Point centre, float angle, int steps);
+
+ /*
+  * Brief     Walk a segment in twice as many (half length) steps
+  * -----------------------------------------------------------------------------------------------*/
+  void RefineSegment(int segment);
+
+  int GetStepCount();
+  int GetSegment(int step);
+
+ /*
+  * Brief     Body motion of one crawl step, in the form CrawlStep() uses
+  * Retval    false if the step is past the end of the path, the body stands still then
+  * -----------------------------------------------------------------------------------------------*/
+  bool GetStep(int step, Point &move, Point &centre, float &angle);
+
+private:
+  struct Segment
+  {
+    float moveX, moveY;
+    float centreX, centreY;
+    float angle;
+    int steps;
+  };
+
+  Segment segments[maxSegments];
+  int segmentCount = 0;
+};
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * File       Frame codec for Project Damson
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include "ProjectDamsonFrame.h"
+
+byte FrameCodec::Encode(const byte packet[], byte length, byte frame[])
+{
+  // Each code byte tells how far the next zero is, the zeros themselves are left out
+  byte codeIndex = 0;
+  byte code = 1;
+  byte frameLength = 1;
+
+  for (byte i = 0; i < length; i++)
+  {
+    if (packet[i] == 0)
+    {
+      frame[codeIndex] = code;
+      codeIndex = frameLength++;
+      code = 1;
+      continue;
+    }
+    frame[frameLength++] = packet[i];
+    if (++code == 0xFF)
+    {
+      frame[codeIndex] = code;
+      codeIndex = frameLength++;
+      code = 1;
+    }
+  }
+  frame[codeIndex] = code;
+  return frameLength;
+}
+
+byte FrameCodec::Decode(const byte frame[], byte length, byte packet[])
+{
+  byte packetLength = 0;
+  byte i = 0;
+
+  while (i < length)
+  {
+    byte code = frame[i++];
+    if (code == 0 || i + code - 1 > length)
+      return 0;
+    for (byte j = 1; j < code; j++)
+      packet[packetLength++] = frame[i++];
+    // A full block (0xFF) and the last block are not followed by a zero
+    if (code < 0xFF && i < length)
+      packet[packetLength++] = 0;
+  }
+  return packetLength;
+}
+
+uint16_t FrameCodec::GetCrc(const byte data[], byte length)
+{
+  uint16_t crc = 0xFFFF;
+  for (byte i = 0; i < length; i++)
+  {
+    crc ^= (uint16_t)data[i] << 8;
+    for (byte bit = 0; bit < 8; bit++)
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+byte FrameCodec::AddCrc(byte packet[], byte length)
+{
+  uint16_t crc = GetCrc(packet, length);
+  packet[length++] = crc >> 8;
+  packet[length++] = crc & 0xFF;
+  return length;
+}
+
+byte FrameCodec::CheckCrc(const byte packet[], byte length)
+{
+  if (length <= crcSize)
+    return 0;
+  length -= crcSize;
+  uint16_t crc = ((uint16_t)packet[length] << 8) | packet[length + 1];
+  return GetCrc(packet, length) == crc ? length : 0;
+}
+
+#endif
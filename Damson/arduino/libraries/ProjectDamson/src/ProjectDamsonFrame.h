@@ -0,0 +1,54 @@
+/*
+ * File       Frame codec for Project Damson
+ * Project    Project Damson
+ * Brief      Framing of protocol v2, see ProjectDamsonOrders.h.
+ *            A packet is protected by CRC-16/CCITT-FALSE (polynomial 0x1021, initial 0xFFFF) and
+ *            COBS encoded, which leaves no zero byte in the frame, so 0x00 delimits the frames and
+ *            the packet can carry any byte. Frames are short, the encoding costs one byte.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include <Arduino.h>
+
+class FrameCodec
+{
+public:
+  static const byte crcSize = 2;
+
+ /*
+  * Brief     COBS encode a packet, without the delimiters
+  * Param     frame     At least length + 1 bytes
+  * Retval    Length of the frame
+  * -----------------------------------------------------------------------------------------------*/
+  static byte Encode(const byte packet[], byte length, byte frame[]);
+
+ /*
+  * Brief     COBS decode a frame, without the delimiters
+  * Param     packet    At least length bytes, may be the frame itself
+  * Retval    Length of the packet, 0 if the frame is malformed
+  * -----------------------------------------------------------------------------------------------*/
+  static byte Decode(const byte frame[], byte length, byte packet[]);
+
+ /*
+  * Brief     CRC of a packet, sent high byte first after it
+  * -----------------------------------------------------------------------------------------------*/
+  static uint16_t GetCrc(const byte data[], byte length);
+
+ /*
+  * Brief     Append the CRC to a packet
+  * Retval    Length with the CRC
+  * -----------------------------------------------------------------------------------------------*/
+  static byte AddCrc(byte packet[], byte length);
+
+ /*
+  * Brief     Check and remove the CRC of a packet
+  * Retval    Length without the CRC, 0 if it is too short or the CRC is wrong
+  * -----------------------------------------------------------------------------------------------*/
+  static byte CheckCrc(const byte packet[], byte length);
+};
+
+#endif
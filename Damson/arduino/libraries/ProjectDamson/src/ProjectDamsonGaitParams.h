@@ -0,0 +1,44 @@
+/*
+ * File       Gait parameters for Project Damson
+ * Project    Project Damson
+ * Brief      Crawl parameters for each action group.
+ *            This file can be regenerated by Damson/tools/GaitOptimizer, which sweeps the
+ *            parameters in a headless simulation of the gait code and exports the best sets.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+struct GaitParams {
+  float crawlLength;   // Distance covered by one whole gait loop (mm)
+  float legLift;       // Height a swinging foot is lifted (mm)
+  float legLiftSpeed;  // Step distance of the swinging legs per control tick (mm)
+};
+
+// =============================================================================
+// PARAMETER SETS (per action group)
+// =============================================================================
+// Format: { crawlLength, legLift, legLiftSpeed }
+
+namespace GaitParamSets {
+
+  // Action group 1 - 2 steps per loop (tripod)
+  constexpr GaitParams group1 = { 42, 20, 7.5 };
+
+  // Action group 2 - 4 steps per loop (ripple)
+  constexpr GaitParams group2 = { 42, 20, 7.5 };
+
+  // Action group 3 - 6 steps per loop (wave)
+  constexpr GaitParams group3 = { 42, 20, 7.5 };
+
+  // Helper to get parameters by action group (1-3)
+  inline const GaitParams& getGroup(int group) {
+    switch (group) {
+      case 2: return group2;
+      case 3: return group3;
+      default: return group1;
+    }
+  }
+
+}  // namespace GaitParamSets
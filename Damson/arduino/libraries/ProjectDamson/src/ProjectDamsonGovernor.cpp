@@ -0,0 +1,74 @@
+/*
+ * File       Supply governor for Project Damson
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include "ProjectDamsonGovernor.h"
+
+namespace {
+
+  // Derating shallower than this is not reported
+  const float eventSpeed = 0.98;
+
+}
+
+void SupplyGovernor::Update(float voltage, float readingVoltage, float seconds)
+{
+  if (voltage < noSupplyVoltage)
+  {
+    speed = 1;
+    sag = 0;
+    if (isDerating)
+    {
+      lastEvent.durationMs = millis() - lastEvent.startMillis;
+      isDerating = false;
+    }
+    return;
+  }
+
+  // The newest sag wins, an older one fades away
+  float newSag = max(0.0f, voltage - readingVoltage);
+  float oldSag = sag - sag * min(1.0f, seconds / sagDecayTime);
+  sag = max(newSag, oldSag);
+
+  float target = min(GetLimit(voltage, fullVoltage, lowVoltage), GetLimit(-sag, -sagStart, -sagFull));
+  // Slow down at once, speed up gradually
+  if (target < speed)
+    speed = target;
+  else
+    speed = min(target, speed + recoveryRate * seconds);
+
+  unsigned long now = millis();
+  if (!isDerating && speed < eventSpeed)
+  {
+    isDerating = true;
+    eventCount++;
+    lastEvent.startMillis = now;
+    lastEvent.voltage = voltage;
+    lastEvent.sag = sag;
+    lastEvent.minSpeed = speed;
+  }
+  if (isDerating)
+  {
+    lastEvent.durationMs = now - lastEvent.startMillis;
+    lastEvent.sag = max(lastEvent.sag, (float)sag);
+    lastEvent.minSpeed = min(lastEvent.minSpeed, (float)speed);
+    if (speed >= eventSpeed)
+      isDerating = false;
+  }
+}
+
+float SupplyGovernor::GetLimit(float value, float full, float low)
+{
+  if (value >= full)
+    return 1;
+  if (value <= low)
+    return minSpeed;
+  return minSpeed + (1 - minSpeed) * (value - low) / (full - low);
+}
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * File       Supply governor for Project Damson
+ * Project    Project Damson
+ * Brief      Slows the moves down while the battery is low or sagging under load.
+ *            The speed factor follows the lower of two limits: the resting voltage (the filtered
+ *            peak of Power) and the recent sag, how far the readings drop below it. A slower move
+ *            draws less current, so a heavy gait degrades instead of browning the servos out.
+ *            Derating starts at once and the speed recovers at recoveryRate. Every stretch of
+ *            derating is counted as an event and the last one is kept for reports.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include <Arduino.h>
+
+class SupplyGovernor
+{
+public:
+  // Full speed above fullVoltage, minSpeed at lowVoltage and below (V)
+  static constexpr float fullVoltage = 7.0;
+  static constexpr float lowVoltage = 6.0;
+  // Below this the power groups are off, there is nothing to protect (V)
+  static constexpr float noSupplyVoltage = 5.5;
+
+  // Full speed up to sagStart, minSpeed from sagFull (V)
+  static constexpr float sagStart = 0.3;
+  static constexpr float sagFull = 1.0;
+  // A sag is remembered for about this long (s)
+  static constexpr float sagDecayTime = 2;
+
+  static constexpr float minSpeed = 0.4;
+  // Speed regained per second once the supply recovers
+  static constexpr float recoveryRate = 0.5;
+
+  struct Event
+  {
+    unsigned long startMillis;
+    unsigned long durationMs;
+    float voltage;      // Resting voltage at the start (V)
+    float sag;          // Largest recent sag (V)
+    float minSpeed;     // Lowest speed factor
+  };
+
+ /*
+  * Brief     Update from the latest supply readings
+  * Param     voltage         Resting voltage (V)
+  *           readingVoltage  Latest reading (V)
+  *           seconds         Time since the last update
+  * -----------------------------------------------------------------------------------------------*/
+  void Update(float voltage, float readingVoltage, float seconds);
+
+ /*
+  * Brief     Speed factor of the moves, 1 at full speed
+  * -----------------------------------------------------------------------------------------------*/
+  float GetSpeed() { return speed; }
+  float GetSag() { return sag; }
+  bool IsDerating() { return isDerating; }
+  unsigned int GetEventCount() { return eventCount; }
+  Event GetLastEvent() { return lastEvent; }
+
+private:
+  volatile float speed = 1;
+  volatile float sag = 0;
+  volatile bool isDerating = false;
+  volatile unsigned int eventCount = 0;
+  Event lastEvent = {};
+
+  static float GetLimit(float value, float full, float low);
+};
+
+#endif
@@ -21,7 +21,8 @@ void IdleAnimations::SetRobotAction(RobotAction* action)
   robotAction = action;
 
   // Seed random number generator with noise from an unconnected analog pin
-  randomSeed(analogRead(A15));
+  // The ADC is busy with the supply voltage, Power lends it for one reading
+  randomSeed(action->robot.power.ReadAnalog(A15));
 }
 
 void IdleAnimations::Update()
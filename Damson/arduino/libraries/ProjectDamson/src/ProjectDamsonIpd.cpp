@@ -0,0 +1,139 @@
+/*
+ * File       ESP8266 data parser for Project Damson
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include "ProjectDamsonIpd.h"
+
+namespace {
+
+  const char prefix[] = "+IPD,";
+  const byte prefixLength = sizeof(prefix) - 1;
+
+  inline bool IsDigit(byte inByte)
+  {
+    return inByte >= '0' && inByte <= '9';
+  }
+
+}
+
+IpdParser::Result IpdParser::Parse(byte inByte)
+{
+  switch (state)
+  {
+  case Text:
+    return ParseText(inByte);
+
+  case LinkId:
+    if (IsDigit(inByte) && digits == 0)
+    {
+      newLinkId = inByte - '0';
+      digits++;
+    }
+    else if (inByte == ',' && digits > 0 && newLinkId <= maxLinkId)
+    {
+      state = Length;
+      length = 0;
+      digits = 0;
+    }
+    else
+    {
+      return ParseText(inByte);
+    }
+    return None;
+
+  case Length:
+    if (IsDigit(inByte) && digits < 4)
+    {
+      length = length * 10 + (inByte - '0');
+      digits++;
+    }
+    else if ((inByte == ':' || inByte == ',') && digits > 0 && length > 0 && length <= maxLength)
+    {
+      state = inByte == ':' ? InData : RemoteInfo;
+      linkId = newLinkId;
+    }
+    else
+    {
+      return ParseText(inByte);
+    }
+    return None;
+
+  case RemoteInfo:
+    // The address is text, a line break means this was no header
+    if (inByte == ':')
+      state = InData;
+    else if (inByte == '\r' || inByte == '\n')
+      return ParseText(inByte);
+    return None;
+
+  case InData:
+    if (--length == 0)
+      Reset();
+    return Data;
+  }
+  return None;
+}
+
+void IpdParser::Reset()
+{
+  state = Text;
+  lineLength = 0;
+  matched = 0;
+}
+
+IpdParser::Result IpdParser::ParseText(byte inByte)
+{
+  Result result = None;
+  if (inByte == '\n')
+  {
+    if (IsLine("SEND OK"))
+      result = SendOk;
+    else if (IsLine("SEND FAIL") || IsLine("ERROR") || IsLine("busy", true))
+      result = Error;
+    lineLength = 0;
+  }
+  else if (inByte != '\r')
+  {
+    // The prompt is followed by a space, not by a line break
+    if (inByte == '>' && lineLength == 0)
+      result = Prompt;
+    if (lineLength < lineSize)
+      line[lineLength] = inByte;
+    if (lineLength < 255)
+      lineLength++;
+  }
+
+  MatchPrefix(inByte);
+  return result;
+}
+
+bool IpdParser::IsLine(const char *text, bool isPrefix)
+{
+  byte length = strlen(text);
+  if (isPrefix ? lineLength < length : lineLength != length)
+    return false;
+  return memcmp(line, text, length) == 0;
+}
+
+void IpdParser::MatchPrefix(byte inByte)
+{
+  state = Text;
+  if (inByte == prefix[matched])
+    matched++;
+  else
+    matched = inByte == prefix[0] ? 1 : 0;
+
+  if (matched == prefixLength)
+  {
+    state = LinkId;
+    matched = 0;
+    digits = 0;
+  }
+}
+
+#endif
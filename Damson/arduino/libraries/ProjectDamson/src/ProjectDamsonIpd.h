@@ -0,0 +1,63 @@
+/*
+ * File       ESP8266 data parser for Project Damson
+ * Project    Project Damson
+ * Brief      Picks the received data out of the output of the ESP8266 AT firmware, one byte at a
+ *            time. Data comes as +IPD,<link id>,<length>:<data>, or with the remote address as
+ *            +IPD,<link id>,<length>,<ip>,<port>:<data>, between text lines such as 0,CONNECT.
+ *            The data may hold any byte, it is taken by the length. A header is matched wherever
+ *            it starts, and one that does not parse is dropped as text.
+ *            Of the text, the replies to AT+CIPSEND are reported: the > prompt at the start of a
+ *            line, SEND OK, and SEND FAIL, ERROR or busy as an error.
+ *            Only the start of a text line is kept, each byte costs the same whatever came before.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include <Arduino.h>
+
+class IpdParser
+{
+public:
+  // Longest data the AT firmware sends in one +IPD, longer headers are dropped
+  static const unsigned int maxLength = 2048;
+  static const byte maxLinkId = 4;
+
+  enum Result : byte { None, Data, Prompt, SendOk, Error };
+
+ /*
+  * Brief     Parse the next byte received from the module
+  * Retval    Data if it is a byte of data, of link GetLinkId(), or the reply it completes
+  * -----------------------------------------------------------------------------------------------*/
+  Result Parse(byte inByte);
+
+  byte GetLinkId() { return linkId; }
+
+ /*
+  * Brief     Forget a header or data in progress, after the module reset
+  * -----------------------------------------------------------------------------------------------*/
+  void Reset();
+
+private:
+  enum State : byte { Text, LinkId, Length, RemoteInfo, InData };
+
+  // Long enough for the replies
+  static const byte lineSize = 10;
+
+  State state = Text;
+  char line[lineSize];
+  byte lineLength = 0;
+  byte matched = 0;       // Bytes of "+IPD," matched so far
+  byte digits = 0;
+  byte linkId = 0;
+  byte newLinkId = 0;
+  unsigned int length = 0;
+
+  Result ParseText(byte inByte);
+  bool IsLine(const char *text, bool isPrefix = false);
+  void MatchPrefix(byte inByte);
+};
+
+#endif
@@ -25,6 +25,13 @@ namespace GlobalServoLimits {
     if (angle > SERVO_MAX) return SERVO_MAX;
     return angle;
   }
+
+  // Same limits for angles in 0.01 degree, keeps sub-degree commands
+  inline int clampCentidegrees(int centidegrees) {
+    if (centidegrees < SERVO_MIN * 100) return SERVO_MIN * 100;
+    if (centidegrees > SERVO_MAX * 100) return SERVO_MAX * 100;
+    return centidegrees;
+  }
 }
 
 /*
@@ -270,6 +277,8 @@ namespace JointConstraints {
 // LEG-TO-LEG COLLISION CONSTRAINTS
 // =============================================================================
 // These define when adjacent legs might collide based on their hip positions.
+// Robot::CheckPoints() already measures adjacent legs from their link geometry
+// (ProjectDamsonCollision.h), these zones add hand measured limits on top.
 
 namespace LegCollisionConstraints {
 
@@ -338,3 +347,259 @@ namespace BodyLimits {
   constexpr int rotateZMax = 15;   // Yaw right
 
 }  // namespace BodyLimits
+
+
+// =============================================================================
+// COMPILED CONSTRAINTS
+// =============================================================================
+// Turns the tables above into one range lookup per leg, used every time a leg
+// is moved. Each table entry compiles to a compare against constants and the
+// tables are walked at compile time, so the cost of a leg only depends on how
+// many entries it has. A leg with default limits and no entries gets no
+// function at all (getApply() returns nullptr).
+//
+// All angles here are servo angles in 0.01 degree, as written to the servos.
+
+namespace LimitsEngine {
+
+  using namespace GlobalServoLimits;
+  using namespace JointConstraints;
+  using namespace LegCollisionConstraints;
+
+  // Constrain value to min~max, min wins if the adjusted range is empty
+  inline void clamp(int &value, int min, int max) {
+    if (value > max) value = max;
+    if (value < min) value = min;
+  }
+
+  // Threshold test of the joint constraints, in 0.01 degree
+  constexpr bool applies(int threshold, bool whenBelow, int angle) {
+    return whenBelow ? angle < threshold * 100 : angle > threshold * 100;
+  }
+
+  constexpr bool isNarrowed(ServoLimit limit) {
+    return limit.min > SERVO_MIN || limit.max < SERVO_MAX;
+  }
+
+  /*
+   * Tables of one leg, so the engine below can be written once for all legs
+   */
+  template <int leg> struct LegTables;
+
+  template <> struct LegTables<1> {
+    static constexpr LegLimits limits() { return ServoLimits::leg1; }
+    static constexpr int femurFromHipCount = Leg1::femurFromHipCount;
+    static constexpr int tibiaFromHipCount = Leg1::tibiaFromHipCount;
+    static constexpr int tibiaFromFemurCount = Leg1::tibiaFromFemurCount;
+    static constexpr FemurConstraint femurFromHip(int i) { return Leg1::femurFromHip[i]; }
+    static constexpr TibiaConstraint tibiaFromHip(int i) { return Leg1::tibiaFromHip[i]; }
+    static constexpr TibiaFromFemurConstraint tibiaFromFemur(int i) { return Leg1::tibiaFromFemur[i]; }
+  };
+
+  template <> struct LegTables<2> {
+    static constexpr LegLimits limits() { return ServoLimits::leg2; }
+    static constexpr int femurFromHipCount = Leg2::femurFromHipCount;
+    static constexpr int tibiaFromHipCount = Leg2::tibiaFromHipCount;
+    static constexpr int tibiaFromFemurCount = Leg2::tibiaFromFemurCount;
+    static constexpr FemurConstraint femurFromHip(int i) { return Leg2::femurFromHip[i]; }
+    static constexpr TibiaConstraint tibiaFromHip(int i) { return Leg2::tibiaFromHip[i]; }
+    static constexpr TibiaFromFemurConstraint tibiaFromFemur(int i) { return Leg2::tibiaFromFemur[i]; }
+  };
+
+  template <> struct LegTables<3> {
+    static constexpr LegLimits limits() { return ServoLimits::leg3; }
+    static constexpr int femurFromHipCount = Leg3::femurFromHipCount;
+    static constexpr int tibiaFromHipCount = Leg3::tibiaFromHipCount;
+    static constexpr int tibiaFromFemurCount = Leg3::tibiaFromFemurCount;
+    static constexpr FemurConstraint femurFromHip(int i) { return Leg3::femurFromHip[i]; }
+    static constexpr TibiaConstraint tibiaFromHip(int i) { return Leg3::tibiaFromHip[i]; }
+    static constexpr TibiaFromFemurConstraint tibiaFromFemur(int i) { return Leg3::tibiaFromFemur[i]; }
+  };
+
+  template <> struct LegTables<4> {
+    static constexpr LegLimits limits() { return ServoLimits::leg4; }
+    static constexpr int femurFromHipCount = Leg4::femurFromHipCount;
+    static constexpr int tibiaFromHipCount = Leg4::tibiaFromHipCount;
+    static constexpr int tibiaFromFemurCount = Leg4::tibiaFromFemurCount;
+    static constexpr FemurConstraint femurFromHip(int i) { return Leg4::femurFromHip[i]; }
+    static constexpr TibiaConstraint tibiaFromHip(int i) { return Leg4::tibiaFromHip[i]; }
+    static constexpr TibiaFromFemurConstraint tibiaFromFemur(int i) { return Leg4::tibiaFromFemur[i]; }
+  };
+
+  template <> struct LegTables<5> {
+    static constexpr LegLimits limits() { return ServoLimits::leg5; }
+    static constexpr int femurFromHipCount = Leg5::femurFromHipCount;
+    static constexpr int tibiaFromHipCount = Leg5::tibiaFromHipCount;
+    static constexpr int tibiaFromFemurCount = Leg5::tibiaFromFemurCount;
+    static constexpr FemurConstraint femurFromHip(int i) { return Leg5::femurFromHip[i]; }
+    static constexpr TibiaConstraint tibiaFromHip(int i) { return Leg5::tibiaFromHip[i]; }
+    static constexpr TibiaFromFemurConstraint tibiaFromFemur(int i) { return Leg5::tibiaFromFemur[i]; }
+  };
+
+  template <> struct LegTables<6> {
+    static constexpr LegLimits limits() { return ServoLimits::leg6; }
+    static constexpr int femurFromHipCount = Leg6::femurFromHipCount;
+    static constexpr int tibiaFromHipCount = Leg6::tibiaFromHipCount;
+    static constexpr int tibiaFromFemurCount = Leg6::tibiaFromFemurCount;
+    static constexpr FemurConstraint femurFromHip(int i) { return Leg6::femurFromHip[i]; }
+    static constexpr TibiaConstraint tibiaFromHip(int i) { return Leg6::tibiaFromHip[i]; }
+    static constexpr TibiaFromFemurConstraint tibiaFromFemur(int i) { return Leg6::tibiaFromFemur[i]; }
+  };
+
+  // The counts are kept by hand next to the tables, check them against the tables
+  static_assert(sizeof(Leg1::femurFromHip) / sizeof(FemurConstraint) == Leg1::femurFromHipCount &&
+                sizeof(Leg1::tibiaFromHip) / sizeof(TibiaConstraint) == Leg1::tibiaFromHipCount &&
+                sizeof(Leg1::tibiaFromFemur) / sizeof(TibiaFromFemurConstraint) == Leg1::tibiaFromFemurCount,
+                "Leg 1 constraint count does not match its table");
+  static_assert(sizeof(Leg2::femurFromHip) / sizeof(FemurConstraint) == Leg2::femurFromHipCount &&
+                sizeof(Leg2::tibiaFromHip) / sizeof(TibiaConstraint) == Leg2::tibiaFromHipCount &&
+                sizeof(Leg2::tibiaFromFemur) / sizeof(TibiaFromFemurConstraint) == Leg2::tibiaFromFemurCount,
+                "Leg 2 constraint count does not match its table");
+  static_assert(sizeof(Leg3::femurFromHip) / sizeof(FemurConstraint) == Leg3::femurFromHipCount &&
+                sizeof(Leg3::tibiaFromHip) / sizeof(TibiaConstraint) == Leg3::tibiaFromHipCount &&
+                sizeof(Leg3::tibiaFromFemur) / sizeof(TibiaFromFemurConstraint) == Leg3::tibiaFromFemurCount,
+                "Leg 3 constraint count does not match its table");
+  static_assert(sizeof(Leg4::femurFromHip) / sizeof(FemurConstraint) == Leg4::femurFromHipCount &&
+                sizeof(Leg4::tibiaFromHip) / sizeof(TibiaConstraint) == Leg4::tibiaFromHipCount &&
+                sizeof(Leg4::tibiaFromFemur) / sizeof(TibiaFromFemurConstraint) == Leg4::tibiaFromFemurCount,
+                "Leg 4 constraint count does not match its table");
+  static_assert(sizeof(Leg5::femurFromHip) / sizeof(FemurConstraint) == Leg5::femurFromHipCount &&
+                sizeof(Leg5::tibiaFromHip) / sizeof(TibiaConstraint) == Leg5::tibiaFromHipCount &&
+                sizeof(Leg5::tibiaFromFemur) / sizeof(TibiaFromFemurConstraint) == Leg5::tibiaFromFemurCount,
+                "Leg 5 constraint count does not match its table");
+  static_assert(sizeof(Leg6::femurFromHip) / sizeof(FemurConstraint) == Leg6::femurFromHipCount &&
+                sizeof(Leg6::tibiaFromHip) / sizeof(TibiaConstraint) == Leg6::tibiaFromHipCount &&
+                sizeof(Leg6::tibiaFromFemur) / sizeof(TibiaFromFemurConstraint) == Leg6::tibiaFromFemurCount,
+                "Leg 6 constraint count does not match its table");
+  static_assert(sizeof(collisionZones) / sizeof(LegPairConstraint) == collisionZoneCount,
+                "Collision zone count does not match its table");
+
+  /*
+   * Table walkers, entry i of n is one compare and the next entry is another
+   * template, so an empty table is an empty function
+   */
+  template <int leg, int i = 0, int n = LegTables<leg>::femurFromHipCount>
+  struct FemurFromHip {
+    static void adjust(int hip, int &min, int &max) {
+      constexpr FemurConstraint c = LegTables<leg>::femurFromHip(i);
+      if (applies(c.hipThreshold, c.whenHipBelow, hip)) {
+        min += c.femurMinAdjust * 100;
+        max += c.femurMaxAdjust * 100;
+      }
+      FemurFromHip<leg, i + 1, n>::adjust(hip, min, max);
+    }
+  };
+  template <int leg, int n> struct FemurFromHip<leg, n, n> {
+    static void adjust(int, int &, int &) {}
+  };
+
+  template <int leg, int i = 0, int n = LegTables<leg>::tibiaFromHipCount>
+  struct TibiaFromHip {
+    static void adjust(int hip, int &min, int &max) {
+      constexpr TibiaConstraint c = LegTables<leg>::tibiaFromHip(i);
+      if (applies(c.hipThreshold, c.whenHipBelow, hip)) {
+        min += c.tibiaMinAdjust * 100;
+        max += c.tibiaMaxAdjust * 100;
+      }
+      TibiaFromHip<leg, i + 1, n>::adjust(hip, min, max);
+    }
+  };
+  template <int leg, int n> struct TibiaFromHip<leg, n, n> {
+    static void adjust(int, int &, int &) {}
+  };
+
+  template <int leg, int i = 0, int n = LegTables<leg>::tibiaFromFemurCount>
+  struct TibiaFromFemur {
+    static void adjust(int femur, int &min, int &max) {
+      constexpr TibiaFromFemurConstraint c = LegTables<leg>::tibiaFromFemur(i);
+      if (applies(c.femurThreshold, c.whenFemurBelow, femur)) {
+        min += c.tibiaMinAdjust * 100;
+        max += c.tibiaMaxAdjust * 100;
+      }
+      TibiaFromFemur<leg, i + 1, n>::adjust(femur, min, max);
+    }
+  };
+  template <int leg, int n> struct TibiaFromFemur<leg, n, n> {
+    static void adjust(int, int &, int &) {}
+  };
+
+  // Collision zones that restrict the hip of this leg, the others are dropped at compile time
+  template <int leg, int i = 0, int n = collisionZoneCount>
+  struct HipFromCollisions {
+    static void adjust(int &hip, const int hips[]) {
+      constexpr LegPairConstraint c = collisionZones[i];
+      if (c.leg2 == leg) {
+        int other = hips[c.leg1 - 1];
+        if (other >= c.leg1HipMin * 100 && other <= c.leg1HipMax * 100 &&
+            hip >= c.leg2HipMin * 100 && hip <= c.leg2HipMax * 100)
+          clamp(hip, c.leg2HipSafeMin * 100, c.leg2HipSafeMax * 100);
+      }
+      HipFromCollisions<leg, i + 1, n>::adjust(hip, hips);
+    }
+  };
+  template <int leg, int n> struct HipFromCollisions<leg, n, n> {
+    static void adjust(int &, const int[]) {}
+  };
+
+  constexpr int countCollisions(int leg, int i = 0) {
+    return i >= collisionZoneCount ? 0 : (collisionZones[i].leg2 == leg) + countCollisions(leg, i + 1);
+  }
+
+  /*
+   * Engine of one leg
+   *
+   * Order: hip from its limits and the collision zones, then femur from its
+   * limits and the hip, then tibia from its limits, the hip and the femur.
+   */
+  template <int leg>
+  struct LegEngine {
+    typedef LegTables<leg> Tables;
+
+    static constexpr bool isEmpty =
+      !isNarrowed(Tables::limits().hip) && !isNarrowed(Tables::limits().femur) &&
+      !isNarrowed(Tables::limits().tibia) && Tables::femurFromHipCount == 0 &&
+      Tables::tibiaFromHipCount == 0 && Tables::tibiaFromFemurCount == 0 &&
+      countCollisions(leg) == 0;
+
+    static void apply(int &hip, int &femur, int &tibia, const int hips[]) {
+      constexpr LegLimits limits = Tables::limits();
+
+      if (isNarrowed(limits.hip))
+        clamp(hip, limits.hip.min * 100, limits.hip.max * 100);
+      HipFromCollisions<leg>::adjust(hip, hips);
+
+      int min = limits.femur.min * 100;
+      int max = limits.femur.max * 100;
+      FemurFromHip<leg>::adjust(hip, min, max);
+      if (isNarrowed(limits.femur) || Tables::femurFromHipCount > 0)
+        clamp(femur, min, max);
+
+      min = limits.tibia.min * 100;
+      max = limits.tibia.max * 100;
+      TibiaFromHip<leg>::adjust(hip, min, max);
+      TibiaFromFemur<leg>::adjust(femur, min, max);
+      if (isNarrowed(limits.tibia) || Tables::tibiaFromHipCount > 0 || Tables::tibiaFromFemurCount > 0)
+        clamp(tibia, min, max);
+    }
+  };
+
+  /*
+   * Constrain the servo angles of one leg
+   * hips are the servo angles of the six hips as last written, for the collision zones
+   */
+  typedef void (*Apply)(int &hip, int &femur, int &tibia, const int hips[]);
+
+  // Engine of a leg by number (1-6), nullptr if the leg has nothing to check
+  inline Apply getApply(int leg) {
+    switch (leg) {
+      case 1: return LegEngine<1>::isEmpty ? nullptr : &LegEngine<1>::apply;
+      case 2: return LegEngine<2>::isEmpty ? nullptr : &LegEngine<2>::apply;
+      case 3: return LegEngine<3>::isEmpty ? nullptr : &LegEngine<3>::apply;
+      case 4: return LegEngine<4>::isEmpty ? nullptr : &LegEngine<4>::apply;
+      case 5: return LegEngine<5>::isEmpty ? nullptr : &LegEngine<5>::apply;
+      case 6: return LegEngine<6>::isEmpty ? nullptr : &LegEngine<6>::apply;
+      default: return nullptr;
+    }
+  }
+
+}  // namespace LimitsEngine
@@ -15,6 +15,25 @@ class Orders
   // Process: The requesting party send the order, then the responding party respond the order.
   //          The non blocking order will be responded immediately, and the blocking order will
   //          be responded orderStart immediately, then respond orderDone after completion.
+  //
+  // Protocol v2, taken on the same links next to the format above and answered in kind
+  // Format:  [frameDelimiter] [COBS([sequence] [order] [data 0] ... [data n] [CRC high] [CRC low])] [frameDelimiter]
+  //          Every byte is 0~255, COBS leaves no 0 inside the frame. CRC is CRC-16/CCITT-FALSE
+  //          over sequence, order and data, see ProjectDamsonFrame.h. Frames may share a delimiter,
+  //          [0] [frame A] [0] [frame B] [0], and extra delimiters between them are ignored.
+  // Process: Same orders as above. A response, orderDone too, repeats the sequence of its order.
+  //          A frame with a wrong CRC is dropped without response, the requesting party retries.
+  // Data:    Signed values are 16-bit little endian instead of 64 + value, in 0.1 mm and 0.1 degree,
+  //          so requestCrawl is [order] [x L] [x H] [y L] [y H] [angle L] [angle H]. Legs, joints,
+  //          I/O ports and servo angles stay one byte. requestCrawlArc takes the centre in 0.1 mm.
+  //          supplyVoltage is [order] [mV L] [mV H], jointHeat has 0~255 percent per servo.
+  //          requestStreamBodyPose takes the frame sequence, newer by 1~127 wrapping at 256, and
+  //          [order] [xMove L] [xMove H] ... [zRotate L] [zRotate H].
+  // Queue:   v2 blocking orders may be sent ahead, up to 8 wait and run in order without a gap.
+  //          Each is responded orderStart with the free slots left, or orderRejected if none is
+  //          free, and orderDone with its sequence once it completes. While orders run or wait,
+  //          requestMoveLeg, requestCalibrate and requestSetServoAngle are responded orderRejected.
+  //          Legacy orders are taken only when nothing runs or waits, as before.
 
 public:
   // Data stream control orders, range is 128 ~ 255
@@ -23,6 +42,9 @@ public:
   static const byte transStart = 128;
   static const byte transEnd = 129;
 
+  // Protocol v2 frame delimiter, before and after every frame
+  static const byte frameDelimiter = 0;
+
 
   // Orders, range is 0 ~ 127
   // Orders are used to control target.
@@ -42,6 +64,10 @@ public:
   static const byte requestSupplyVoltage = 10;      // [order]
   // Respond supply voltage
   static const byte supplyVoltage = 11;             // [order] [voltage * 100 / 128] [voltage * 100 % 128]
+  // Request estimated servo heat
+  static const byte requestJointHeat = 12;          // [order]
+  // Respond estimated servo heat, percent of the budget 0~127 of legs 1~6, joints A, B, C each
+  static const byte jointHeat = 13;                 // [order] [heat 1A] [heat 1B] [heat 1C] ... [heat 6C]
   // Request change I/O port state
   static const byte requestChangeIO = 20;           // [order] [IOindex] [1/0]
 
@@ -51,8 +77,36 @@ public:
 
   // Motor testing (bypasses safety limits - use with caution!)
   // leg: 1-6, joint: 0=A(hip), 1=B(femur), 2=C(tibia), angle: 0-180
+  // Responded orderRejected while the robot sleeps in low power, any blocking order wakes it up
   static const byte requestSetServoAngle = 34;      // [order] [leg] [joint] [angle]
 
+  // Streaming, sent at up to 50 Hz and not responded
+  // The robot eases toward the latest body pose every control tick, a setpoint with an older
+  // sequence (0~127, wrapping) than the last one is dropped. Streaming stops 500 ms after the last setpoint.
+  static const byte requestStreamBodyPose = 40;     // [order] [sequence] [64 + xMove] [64 + yMove] [64 + zMove] [64 + xRotate] [64 + yRotate] [64 + zRotate]
+
+  // Queue, v2 only
+  // Drop the blocking orders that wait, the one that runs completes. Responded orderDone
+  static const byte requestClearOrders = 42;        // [order]
+
+  // Telemetry, v2 only
+  // Push telemetry every period control ticks (20 ms) to the link of the
+  // request, period 0 stops it. Responded orderDone. The frames count their own sequence
+  // A frame that does not fit in the transmit queue is dropped and leaves a gap in the sequence,
+  // the serial port sends about 64 bytes per control tick
+  static const byte requestTelemetry = 44;          // [order] [period] [fields]
+  // Pushed, the chosen fields follow in the order of their bits, values as in v2
+  static const byte telemetry = 45;                 // [order] [fields] [field data] ...
+  // Joint angles (0.1 degree), leg 1 A, B, C ... leg 6 C
+  static const byte telemetryJoints = 0x01;         // 18 x [angle L] [angle H]
+  // Feet in body coordinates (0.1 mm), leg 1 x, y, z ... leg 6 z
+  static const byte telemetryFeet = 0x02;           // 18 x [value L] [value H]
+  static const byte telemetryVoltage = 0x04;        // [mV L] [mV H]
+  // Control loop period, work of the last tick and longest work since the last frame (us)
+  static const byte telemetryTiming = 0x08;         // [period L] [period H] [work L] [work H] [max L] [max H]
+  // Blocking orders waiting, and 1 if one runs
+  static const byte telemetryQueue = 0x10;          // [waiting] [running]
+
   // Blocking orders, range is 64 ~ 127
 
   // Installation
@@ -78,10 +132,14 @@ public:
   static const byte requestMoveBody = 114;          // [order] [64 + x] [64 + y] [64 + z]
   static const byte requestRotateBody = 116;        // [order] [64 + x] [64 + y] [64 + z]
   static const byte requestTwistBody = 118;         // [order] [64 + xMove] [64 + yMove] [64 + zMove] [64 + xRotate] [64 + yRotate] [64 + zRotate]
+  static const byte requestCrawlArc = 120;          // [order] [64 + xCentre / 10] [64 + yCentre / 10] [64 + angle]
 
   // Universal responded orders, range is 21 ~ 127
   // These orders are used to respond orders without proprietary response orders.
 
-  static const byte orderStart = 21;                // [order]
+  static const byte orderStart = 21;                // [order], v2 [order] [free queue slots]
   static const byte orderDone = 23;                 // [order]
+  // The order was not taken: v2 when the queue is full or it has to wait for the queue, and
+  // requestSetServoAngle in low power
+  static const byte orderRejected = 25;             // [order]
 };
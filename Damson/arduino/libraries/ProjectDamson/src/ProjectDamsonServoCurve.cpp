@@ -0,0 +1,53 @@
+/*
+ * File       Servo calibration curve for Project Damson
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include "ProjectDamsonServoCurve.h"
+
+ServoCurve::ServoCurve()
+{
+  SetLinear(0, 0);
+}
+
+void ServoCurve::SetLinear(unsigned int minTicks, unsigned int maxTicks)
+{
+  unsigned int knotTicks[knots];
+  for (byte i = 0; i < knots; i++)
+    knotTicks[i] = minTicks + (unsigned int)(((unsigned long)(maxTicks - minTicks) * i + segments / 2) / segments);
+
+  if (!Set(knotTicks))
+  {
+    // Empty range, every angle gives the same pulse
+    for (byte i = 0; i < segments; i++)
+    {
+      segmentTicks[i] = minTicks;
+      segmentSlopes[i] = 0;
+    }
+  }
+}
+
+bool ServoCurve::Set(const unsigned int knotTicks[knots])
+{
+  for (byte i = 0; i < segments; i++)
+  {
+    if (knotTicks[i + 1] <= knotTicks[i])
+      return false;
+    if (((unsigned long)(knotTicks[i + 1] - knotTicks[i]) << slopeShift) / segmentCentidegrees > 0xFFFF)
+      return false;
+  }
+
+  for (byte i = 0; i < segments; i++)
+  {
+    unsigned long span = (unsigned long)(knotTicks[i + 1] - knotTicks[i]) << slopeShift;
+    segmentTicks[i] = knotTicks[i];
+    segmentSlopes[i] = (span + segmentCentidegrees / 2) / segmentCentidegrees;
+  }
+  return true;
+}
+
+#endif
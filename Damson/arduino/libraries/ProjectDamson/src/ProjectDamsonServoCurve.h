@@ -0,0 +1,62 @@
+/*
+ * File       Servo calibration curve for Project Damson
+ * Project    Project Damson
+ * Brief      Piecewise-linear servo angle to pulse width curve.
+ *            The curve has a knot every 30 degrees. It is kept as a segment table (start ticks and
+ *            a fixed-point slope per segment), so a pulse is one 16x16 bit multiply and a shift,
+ *            without float work in the control tick.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include <Arduino.h>
+
+class ServoCurve
+{
+public:
+  static const byte segments = 6;
+  static const byte knots = segments + 1;
+  static const int segmentCentidegrees = 18000 / segments;
+
+  ServoCurve();
+
+ /*
+  * Brief     Straight line through the pulses of 0 and 180 degrees
+  * Param     minTicks, maxTicks    Pulse widths in driver ticks
+  * -----------------------------------------------------------------------------------------------*/
+  void SetLinear(unsigned int minTicks, unsigned int maxTicks);
+
+ /*
+  * Brief     Curve through a pulse at every knot, knot i is at servo angle i * 30
+  * Param     knotTicks   Pulse widths in driver ticks, must rise from knot to knot
+  * Retval    Whether the curve is valid, the curve is left unchanged if not
+  * -----------------------------------------------------------------------------------------------*/
+  bool Set(const unsigned int knotTicks[knots]);
+
+ /*
+  * Brief     Pulse width of a servo angle
+  * Param     centidegrees    Servo angle 0~18000 (0.01 degree)
+  * Retval    Pulse width in driver ticks
+  * -----------------------------------------------------------------------------------------------*/
+  unsigned int GetTicks(unsigned int centidegrees) const
+  {
+    byte segment = centidegrees / segmentCentidegrees;
+    if (segment >= segments)
+      segment = segments - 1;
+    unsigned int into = centidegrees - segment * segmentCentidegrees;
+    return segmentTicks[segment] + (unsigned int)(((unsigned long)into * segmentSlopes[segment] + slopeRound) >> slopeShift);
+  }
+
+private:
+  // Slopes are ticks per 0.01 degree in Q2.14, enough for 2600 us over one segment
+  static const byte slopeShift = 14;
+  static const unsigned long slopeRound = 1UL << (slopeShift - 1);
+
+  unsigned int segmentTicks[segments];
+  unsigned int segmentSlopes[segments];
+};
+
+#endif
@@ -0,0 +1,300 @@
+/*
+ * File       Servo driver for Project Damson
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include "ProjectDamsonServoDriver.h"
+
+namespace {
+
+  const byte timerCount = 3;
+  const byte slotsPerTimer = 6;
+
+  // Prescaler 8, 0.5 us per tick
+  const unsigned int frameTicks = 40000;
+  const unsigned int slotTicks = frameTicks / slotsPerTimer;
+  // First rising edge, keeps every compare value clear of the counter wrap
+  const unsigned int firstEdgeTicks = 100;
+  // Interrupts are raised this early and wait for the exact count
+  const unsigned int edgeLeadTicks = 16;
+  // An edge written this far past its count was delayed by another interrupt
+  const unsigned int lateEdgeTicks = 2;
+
+  struct Channel
+  {
+    volatile uint8_t *port;
+    uint8_t mask;
+    volatile unsigned int ticks;
+    ServoCurve curve;
+  };
+
+  // Channel c is in slot c / 3 of timer c % 3, so consecutive channels rise 1.11 ms apart
+  Channel channels[ServoDriver::maxChannels];
+  byte channelCount = 0;
+
+  volatile byte nextSlot[timerCount];
+  Channel *volatile fallChannel[timerCount];
+  volatile unsigned int fallTicks[timerCount];
+
+  bool isStarted = false;
+
+  volatile unsigned long writeCount = 0;
+  volatile unsigned long skippedWriteCount = 0;
+  volatile unsigned long lateEdgeCount = 0;
+
+  inline unsigned int GetSlotStart(byte slot)
+  {
+    return firstEdgeTicks + slot * slotTicks;
+  }
+
+  inline void HandleRise(byte timer, volatile uint16_t &ocrA, volatile uint16_t &ocrB, volatile uint16_t &tcnt)
+  {
+    byte slot = nextSlot[timer];
+    Channel &channel = channels[slot * timerCount + timer];
+    unsigned int start = GetSlotStart(slot);
+    unsigned int ticks = channel.ticks;
+
+    if (channel.port != NULL && ticks != 0)
+    {
+      unsigned int now;
+      while ((now = tcnt) < start)
+        ;
+      *channel.port |= channel.mask;
+
+      // A late rise moves the pulse, the fall is timed from the rise so the width stays
+      if (now > start + lateEdgeTicks)
+      {
+        lateEdgeCount++;
+        start = now;
+      }
+      fallTicks[timer] = start + ticks;
+      fallChannel[timer] = &channel;
+      ocrB = start + ticks - edgeLeadTicks;
+    }
+
+    slot = slot + 1 < slotsPerTimer ? slot + 1 : 0;
+    nextSlot[timer] = slot;
+    ocrA = GetSlotStart(slot) - edgeLeadTicks;
+  }
+
+  inline void HandleFall(byte timer, volatile uint16_t &tcnt)
+  {
+    Channel *channel = fallChannel[timer];
+    if (channel == NULL)
+      return;
+
+    unsigned int end = fallTicks[timer];
+    unsigned int now;
+    while ((now = tcnt) < end)
+      ;
+    *channel->port &= ~channel->mask;
+    fallChannel[timer] = NULL;
+
+    // A late fall widens the pulse, it can only be counted
+    if (now > end + lateEdgeTicks)
+      lateEdgeCount++;
+  }
+
+  void Start()
+  {
+    // Halt the prescaler so the three timers start together, at their phase offsets
+    GTCCR = _BV(TSM) | _BV(PSRSYNC);
+
+    // CTC with TOP = ICRn, prescaler 8
+    TCCR1A = 0;
+    TCCR1B = _BV(WGM13) | _BV(WGM12) | _BV(CS11);
+    ICR1 = frameTicks - 1;
+    TCNT1 = 0;
+    OCR1A = GetSlotStart(0) - edgeLeadTicks;
+    TIFR1 = _BV(OCF1A) | _BV(OCF1B);
+    TIMSK1 = _BV(OCIE1A) | _BV(OCIE1B);
+
+    TCCR3A = 0;
+    TCCR3B = _BV(WGM33) | _BV(WGM32) | _BV(CS31);
+    ICR3 = frameTicks - 1;
+    TCNT3 = frameTicks - slotTicks / timerCount;
+    OCR3A = GetSlotStart(0) - edgeLeadTicks;
+    TIFR3 = _BV(OCF3A) | _BV(OCF3B);
+    TIMSK3 = _BV(OCIE3A) | _BV(OCIE3B);
+
+    TCCR4A = 0;
+    TCCR4B = _BV(WGM43) | _BV(WGM42) | _BV(CS41);
+    ICR4 = frameTicks - 1;
+    TCNT4 = frameTicks - slotTicks * 2 / timerCount;
+    OCR4A = GetSlotStart(0) - edgeLeadTicks;
+    TIFR4 = _BV(OCF4A) | _BV(OCF4B);
+    TIMSK4 = _BV(OCIE4A) | _BV(OCIE4B);
+
+    GTCCR = 0;
+    isStarted = true;
+  }
+
+}
+
+ISR(TIMER1_COMPA_vect) { HandleRise(0, OCR1A, OCR1B, TCNT1); }
+ISR(TIMER1_COMPB_vect) { HandleFall(0, TCNT1); }
+ISR(TIMER3_COMPA_vect) { HandleRise(1, OCR3A, OCR3B, TCNT3); }
+ISR(TIMER3_COMPB_vect) { HandleFall(1, TCNT3); }
+ISR(TIMER4_COMPA_vect) { HandleRise(2, OCR4A, OCR4B, TCNT4); }
+ISR(TIMER4_COMPB_vect) { HandleFall(2, TCNT4); }
+
+byte ServoDriver::Attach(byte pin)
+{
+  if (channelCount >= maxChannels)
+    return invalidChannel;
+
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+
+  byte channel = channelCount++;
+  uint8_t oldSREG = SREG;
+  cli();
+  channels[channel].port = portOutputRegister(digitalPinToPort(pin));
+  channels[channel].mask = digitalPinToBitMask(pin);
+  channels[channel].ticks = 0;
+  SREG = oldSREG;
+  SetPulseRange(channel, defaultMinPulse, defaultMaxPulse);
+
+  if (!isStarted)
+    Start();
+  return channel;
+}
+
+void ServoDriver::Detach(byte channel)
+{
+  if (!IsAttached(channel))
+    return;
+
+  // The channel stays reserved, its pin is left low
+  WriteTicks(channel, 0);
+}
+
+bool ServoDriver::IsAttached(byte channel)
+{
+  return channel < channelCount;
+}
+
+void ServoDriver::SetPulseRange(byte channel, unsigned int minPulse, unsigned int maxPulse)
+{
+  if (!IsAttached(channel))
+    return;
+
+  minPulse = constrain(minPulse, ServoDriver::minPulse, ServoDriver::maxPulse);
+  maxPulse = constrain(maxPulse, minPulse, ServoDriver::maxPulse);
+  ServoCurve curve;
+  curve.SetLinear(minPulse * ticksPerMicrosecond, maxPulse * ticksPerMicrosecond);
+  SetPulseCurve(channel, curve);
+}
+
+void ServoDriver::SetPulseCurve(byte channel, const ServoCurve &curve)
+{
+  if (!IsAttached(channel))
+    return;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  channels[channel].curve = curve;
+  SREG = oldSREG;
+}
+
+void ServoDriver::Write(byte channel, float angle)
+{
+  angle = constrain(angle, 0, 180);
+  WriteCentidegrees(channel, (int)(angle * centidegreesPerDegree + 0.5));
+}
+
+void ServoDriver::WriteCentidegrees(byte channel, int centidegrees)
+{
+  if (!IsAttached(channel))
+    return;
+
+  centidegrees = constrain(centidegrees, 0, 180 * centidegreesPerDegree);
+  WriteTicks(channel, channels[channel].curve.GetTicks(centidegrees));
+}
+
+void ServoDriver::WriteMicroseconds(byte channel, float microseconds)
+{
+  microseconds = constrain(microseconds, minPulse, maxPulse);
+  WriteTicks(channel, (unsigned int)(microseconds * ticksPerMicrosecond + 0.5));
+}
+
+void ServoDriver::WriteTicks(byte channel, unsigned int ticks)
+{
+  if (!IsAttached(channel))
+    return;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  if (channels[channel].ticks == ticks)
+  {
+    skippedWriteCount++;
+  }
+  else
+  {
+    channels[channel].ticks = ticks;
+    writeCount++;
+  }
+  SREG = oldSREG;
+}
+
+unsigned int ServoDriver::ReadTicks(byte channel)
+{
+  if (!IsAttached(channel))
+    return 0;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  unsigned int ticks = channels[channel].ticks;
+  SREG = oldSREG;
+  return ticks;
+}
+
+unsigned long ServoDriver::GetWriteCount()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  unsigned long count = writeCount;
+  SREG = oldSREG;
+  return count;
+}
+
+unsigned long ServoDriver::GetSkippedWriteCount()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  unsigned long count = skippedWriteCount;
+  SREG = oldSREG;
+  return count;
+}
+
+void ServoDriver::ResetWriteCounts()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  writeCount = 0;
+  skippedWriteCount = 0;
+  SREG = oldSREG;
+}
+
+unsigned long ServoDriver::GetLateEdgeCount()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  unsigned long count = lateEdgeCount;
+  SREG = oldSREG;
+  return count;
+}
+
+void ServoDriver::ResetLateEdgeCount()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  lateEdgeCount = 0;
+  SREG = oldSREG;
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * File       Servo driver for Project Damson
+ * Project    Project Damson
+ * Brief      18 channel servo pulse generator on the 16-bit timers 1, 3 and 4 of the Mega 2560.
+ *            The 20 ms frame of each timer is split into 6 slots, one channel per slot, and the
+ *            three timers are shifted by a third of a slot. Rising edges of the 18 channels are
+ *            therefore spread evenly (1.11 ms apart) instead of all servos starting at once.
+ *            Pulses have 0.5 us resolution. The servo pins are plain I/O pins, so edges are written
+ *            in the compare interrupts. Each interrupt is raised a few microseconds early and waits
+ *            for the exact timer count, which hides the usual interrupt latency. An edge is still
+ *            late when another interrupt runs past its count: the falls of the three timers are not
+ *            kept apart like the rises, and the ADC and serial interrupts can get in the way too.
+ *            A late rise moves the pulse and keeps its width, a late fall widens the pulse. Late
+ *            edges are counted, examples/Benchmarks/ServoJitter measures the jitter with colliding
+ *            falls. The worst case has not been measured on the robot yet, it is estimated at one
+ *            spinning compare interrupt and one other interrupt, about 15 us.
+ *            Timers 1, 3 and 4 can not be used by anything else, including the Servo library.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include <Arduino.h>
+#include "ProjectDamsonServoCurve.h"
+
+class ServoDriver
+{
+public:
+  static const byte maxChannels = 18;
+  static const byte invalidChannel = 255;
+
+  // Pulse range of 0 and 180 degrees until set per channel, same as the Arduino Servo library
+  static const unsigned int defaultMinPulse = 544;
+  static const unsigned int defaultMaxPulse = 2400;
+
+  // Pulses outside this range are limited
+  static const unsigned int minPulse = 400;
+  static const unsigned int maxPulse = 2600;
+
+  static const byte ticksPerMicrosecond = 2;
+  static const int centidegreesPerDegree = 100;
+
+ /*
+  * Brief     Attach a pin to the next free channel, the pin is held low until a pulse is written
+  * Retval    The channel, or invalidChannel if all are used
+  * -----------------------------------------------------------------------------------------------*/
+  static byte Attach(byte pin);
+  static void Detach(byte channel);
+  static bool IsAttached(byte channel);
+
+ /*
+  * Brief     Set the pulses of 0 and 180 degrees of a channel, for servos with another range
+  * Param     minPulse, maxPulse    Pulse widths (us), limited to minPulse~maxPulse
+  * -----------------------------------------------------------------------------------------------*/
+  static void SetPulseRange(byte channel, unsigned int minPulse, unsigned int maxPulse);
+
+ /*
+  * Brief     Set the calibration curve of a channel, replaces the pulse range
+  * -----------------------------------------------------------------------------------------------*/
+  static void SetPulseCurve(byte channel, const ServoCurve &curve);
+
+ /*
+  * Brief     Set the pulse of a channel, used from the next frame
+  * Param     angle           Servo angle 0~180, fractions are kept
+  *           centidegrees    Servo angle 0~18000 (0.01 degree), converted by the channel curve
+  *           microseconds    Pulse width, fractions are rounded to 0.5 us
+  * -----------------------------------------------------------------------------------------------*/
+  static void Write(byte channel, float angle);
+  static void WriteCentidegrees(byte channel, int centidegrees);
+  static void WriteMicroseconds(byte channel, float microseconds);
+  static void WriteTicks(byte channel, unsigned int ticks);
+  static unsigned int ReadTicks(byte channel);
+
+ /*
+  * Brief     Pulse writes since start, a write that would not change the pulse is skipped
+  * -----------------------------------------------------------------------------------------------*/
+  static unsigned long GetWriteCount();
+  static unsigned long GetSkippedWriteCount();
+  static void ResetWriteCounts();
+
+ /*
+  * Brief     Edges written more than 1 us past their count since start or the last reset
+  * -----------------------------------------------------------------------------------------------*/
+  static unsigned long GetLateEdgeCount();
+  static void ResetLateEdgeCount();
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * File       Static stability for Project Damson
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include "ProjectDamsonStability.h"
+
+SupportPolygon::SupportPolygon() {}
+
+SupportPolygon::SupportPolygon(RobotLegsPoints points, byte stanceLegs)
+{
+  const Point feet[6] = { points.leg1, points.leg2, points.leg3, points.leg4, points.leg5, points.leg6 };
+
+  // Sort the stance feet by x, then y (insertion sort, at most 6 points)
+  float px[6], py[6];
+  int n = 0;
+  for (int i = 0; i < 6; i++)
+  {
+    if (!(stanceLegs & (1 << i)))
+      continue;
+    int j = n++;
+    while (j > 0 && (px[j - 1] > feet[i].x || (px[j - 1] == feet[i].x && py[j - 1] > feet[i].y)))
+    {
+      px[j] = px[j - 1];
+      py[j] = py[j - 1];
+      j--;
+    }
+    px[j] = feet[i].x;
+    py[j] = feet[i].y;
+  }
+
+  if (n < 3)
+  {
+    count = 0;
+    return;
+  }
+
+  // Monotone chain, counter clockwise hull
+  float hx[12], hy[12];
+  int k = 0;
+  for (int pass = 0; pass < 2; pass++)
+  {
+    int start = k;
+    for (int m = 0; m < n; m++)
+    {
+      int i = pass == 0 ? m : n - 1 - m;
+      while (k >= start + 2 &&
+             (hx[k - 1] - hx[k - 2]) * (py[i] - hy[k - 2]) - (hy[k - 1] - hy[k - 2]) * (px[i] - hx[k - 2]) <= 0)
+        k--;
+      hx[k] = px[i];
+      hy[k] = py[i];
+      k++;
+    }
+    k--;
+  }
+
+  count = k;
+  for (int i = 0; i < count; i++)
+  {
+    x[i] = hx[i];
+    y[i] = hy[i];
+  }
+  if (count < 3)
+    count = 0;
+}
+
+float SupportPolygon::GetMargin(Point point)
+{
+  if (count == 0)
+    return noMargin;
+
+  float margin = -noMargin;
+  for (int i = 0; i < count; i++)
+  {
+    int j = (i + 1) % count;
+    float ex = x[j] - x[i];
+    float ey = y[j] - y[i];
+    float length = sqrt(ex * ex + ey * ey);
+    if (length == 0)
+      continue;
+    float distance = (ex * (point.y - y[i]) - ey * (point.x - x[i])) / length;
+    if (distance < margin)
+      margin = distance;
+  }
+  return margin;
+}
+
+Point SupportPolygon::GetCentroid()
+{
+  Point centroid(0, 0, 0);
+  if (count == 0)
+    return centroid;
+
+  for (int i = 0; i < count; i++)
+  {
+    centroid.x += x[i];
+    centroid.y += y[i];
+  }
+  centroid.x /= count;
+  centroid.y /= count;
+  return centroid;
+}
+
+Point SupportPolygon::GetSwayOffset(RobotLegsPoints startPoints, RobotLegsPoints endPoints, byte stanceLegs, float minMargin, float maxSway)
+{
+  SupportPolygon start(startPoints, stanceLegs);
+  SupportPolygon end(endPoints, stanceLegs);
+  Point centreOfMass(centreOfMassX, centreOfMassY, 0);
+
+  if (min(start.GetMargin(centreOfMass), end.GetMargin(centreOfMass)) >= minMargin)
+    return Point(0, 0, 0);
+
+  // Head for the middle of the polygon the feet share, start and end centroids averaged
+  Point startCentroid = start.GetCentroid();
+  Point endCentroid = end.GetCentroid();
+  float dx = (startCentroid.x + endCentroid.x) / 2 - centreOfMass.x;
+  float dy = (startCentroid.y + endCentroid.y) / 2 - centreOfMass.y;
+  float length = sqrt(dx * dx + dy * dy);
+  if (length > maxSway)
+  {
+    dx = dx * maxSway / length;
+    dy = dy * maxSway / length;
+  }
+
+  // Bisect for the smallest sway along that direction which reaches the margin
+  float low = 0, high = 1;
+  for (int i = 0; i < 8; i++)
+  {
+    float t = (low + high) / 2;
+    Point sway(centreOfMass.x + dx * t, centreOfMass.y + dy * t, 0);
+    if (min(start.GetMargin(sway), end.GetMargin(sway)) >= minMargin)
+      high = t;
+    else
+      low = t;
+  }
+
+  return Point(dx * high, dy * high, 0);
+}
+
+#endif
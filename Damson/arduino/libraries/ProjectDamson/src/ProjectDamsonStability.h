@@ -0,0 +1,57 @@
+/*
+ * File       Static stability for Project Damson
+ * Project    Project Damson
+ * Brief      Support polygon of the stance feet and the stability margin of the body centre.
+ *            Used by the gait planner to sway the body while legs are lifted.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include "ProjectDamsonBasic.h"
+
+class SupportPolygon
+{
+public:
+  SupportPolygon();
+
+ /*
+  * Brief     Build the support polygon (convex hull) of the stance feet
+  * Param     points        Feet points in the body frame
+  *           stanceLegs    Bit mask of the legs on the ground, bit 0 = leg 1
+  * -----------------------------------------------------------------------------------------------*/
+  SupportPolygon(RobotLegsPoints points, byte stanceLegs);
+
+ /*
+  * Brief     Signed horizontal distance from a point to the nearest polygon edge
+  * Retval    Positive inside the polygon, negative outside, noMargin if fewer than 3 feet
+  * -----------------------------------------------------------------------------------------------*/
+  float GetMargin(Point point);
+
+  Point GetCentroid();
+
+ /*
+  * Brief     Body offset that keeps the centre of mass inside both support polygons by minMargin
+  *           The stance feet are checked at the start and the end of a swing.
+  * Param     startPoints, endPoints    Feet points before and after the swing
+  *           stanceLegs                Bit mask of the legs on the ground during the swing
+  *           minMargin                 Required stability margin (mm)
+  *           maxSway                   Largest allowed body offset (mm)
+  * Retval    Body offset, the feet move by the opposite. (0, 0, 0) if no sway is needed.
+  * -----------------------------------------------------------------------------------------------*/
+  static Point GetSwayOffset(RobotLegsPoints startPoints, RobotLegsPoints endPoints, byte stanceLegs, float minMargin, float maxSway);
+
+  static constexpr float noMargin = -1000;
+
+  // The centre of mass is assumed at the body origin
+  static constexpr float centreOfMassX = 0;
+  static constexpr float centreOfMassY = 0;
+
+private:
+  float x[6], y[6];
+  int count = 0;
+};
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * File       Joint thermal estimator for Project Damson
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include "ProjectDamsonThermal.h"
+
+JointThermal::JointThermal()
+{
+  for (byte i = 0; i < joints; i++)
+  {
+    lastAngle[i] = 0;
+    motion[i] = 0;
+    heat[i] = 0;
+    hasAngle[i] = false;
+  }
+}
+
+void JointThermal::AddMotion(byte joint, float servoAngle)
+{
+  if (joint >= joints)
+    return;
+
+  if (hasAngle[joint])
+    motion[joint] += fabs(servoAngle - lastAngle[joint]);
+  lastAngle[joint] = servoAngle;
+  hasAngle[joint] = true;
+}
+
+void JointThermal::Update(byte joint, float load, float seconds)
+{
+  if (joint >= joints)
+    return;
+
+  float input = motionHeat * motion[joint] + loadHeat * load * seconds;
+  motion[joint] = 0;
+  // Cooling is limited to the whole heat, for long gaps between updates
+  float cooling = heat[joint] * min(1.0f, seconds / timeConstant);
+  heat[joint] = max(0.0f, heat[joint] + input - cooling);
+}
+
+void JointThermal::UpdateThrottle()
+{
+  float maxHeat = GetMaxHeat();
+  if (maxHeat <= throttleStart)
+    throttle = 1;
+  else if (maxHeat >= 1)
+    throttle = minThrottle;
+  else
+    throttle = 1 - (1 - minThrottle) * (maxHeat - throttleStart) / (1 - throttleStart);
+}
+
+float JointThermal::GetMaxHeat() const
+{
+  float maxHeat = 0;
+  for (byte i = 0; i < joints; i++)
+    maxHeat = max(maxHeat, heat[i]);
+  return maxHeat;
+}
+
+#endif
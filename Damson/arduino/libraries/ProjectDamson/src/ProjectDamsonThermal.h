@@ -0,0 +1,68 @@
+/*
+ * File       Joint thermal estimator for Project Damson
+ * Project    Project Damson
+ * Brief      Estimates how hard each servo is working from the commanded motion and the holding
+ *            load of the body weight. Each joint has a heat value with a first-order time constant,
+ *            1 is the budget of the joint. Past throttleStart the planner slows down the moves.
+ *            The model is relative, not a temperature. Its constants are rough figures for MG90S
+ *            servos: standing on a tripod is about 40% and sweeping 300 deg/s without end is 100%.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+#if defined(ARDUINO_AVR_MEGA2560)
+
+#include <Arduino.h>
+
+class JointThermal
+{
+public:
+  static const byte joints = 18;
+
+  // Heating and cooling time constant (s)
+  static constexpr float timeConstant = 90;
+  // Heat per degree moved, and per second of holding load (share of body weight * lever in mm)
+  static constexpr float motionHeat = 1.0 / 300 / timeConstant;
+  static constexpr float loadHeat = 0.018 / timeConstant;
+
+  // Moves are slowed from throttleStart and down to minThrottle at the budget
+  static constexpr float throttleStart = 0.8;
+  static constexpr float minThrottle = 0.4;
+
+  JointThermal();
+
+ /*
+  * Brief     Add the motion of one control tick
+  * Param     joint         Joint index, (leg - 1) * 3 + joint
+  *           servoAngle    Commanded servo angle (degree)
+  * -----------------------------------------------------------------------------------------------*/
+  void AddMotion(byte joint, float servoAngle);
+
+ /*
+  * Brief     Turn the motion added since the last update and the holding load into heat
+  * Param     load      Share of body weight times the lever (mm), 0 if the joint holds nothing
+  *           seconds   Time since the last update
+  * -----------------------------------------------------------------------------------------------*/
+  void Update(byte joint, float load, float seconds);
+
+ /*
+  * Brief     Update the speed throttle from the hottest joint, after updating every joint
+  * -----------------------------------------------------------------------------------------------*/
+  void UpdateThrottle();
+
+  // Motion added since the last update (degree)
+  float GetMotion(byte joint) const { return joint < joints ? motion[joint] : 0; }
+  float GetHeat(byte joint) const { return joint < joints ? heat[joint] : 0; }
+  float GetMaxHeat() const;
+  float GetThrottle() const { return throttle; }
+
+private:
+  float lastAngle[joints];
+  float motion[joints];
+  float heat[joints];
+  bool hasAngle[joints];
+  volatile float throttle = 1;
+};
+
+#endif
@@ -32,6 +32,7 @@
 
 ProjectDamson damson;
 String inputBuffer = "";
+unsigned int reportedDeratings = 0;
 
 void printHelp() {
   Serial.println(F(""));
@@ -67,14 +68,80 @@ void printHelp() {
   Serial.println(F("  idle on     - Enable auto animations"));
   Serial.println(F("  idle off    - Disable auto animations"));
   Serial.println(F("  timeout N   - Set idle timeout (seconds)"));
+  Serial.println(F("  outputs     - Show IK solves and servo writes skipped as unchanged"));
+  Serial.println(F("  heat        - Show estimated servo heat (% of budget) and speed throttle"));
+  Serial.println(F("  power       - Show supply voltage, speed factor and the last derating"));
+  Serial.println(F("  energy      - Show estimated energy of the last gait loop"));
+  Serial.println(F("  bench N     - Crawl forward N loops in each action group and compare energy"));
   Serial.println(F(""));
   Serial.println(F("Motor Testing (bypasses limits!):"));
   Serial.println(F("  servo L J A - Set servo angle directly"));
   Serial.println(F("                L=leg(1-6) J=joint(0-2) A=angle(0-180)"));
   Serial.println(F("                Joint: 0=Hip, 1=Femur, 2=Tibia"));
+  Serial.println(F("  pulse L J N X - Set servo pulse range (us) of 0 and 180 degrees"));
+  Serial.println(F("                N=min(400-2600) X=max(400-2600), saved to EEPROM"));
+  Serial.println(F("  curve L J A C - Correct the pulse (us) at servo angle A"));
+  Serial.println(F("                A=30/60/90/120/150 C=-63.5~63.5, saved to EEPROM"));
+  Serial.println(F("  curve L J   - Show the pulse corrections of a servo"));
+  Serial.println(F("  curve L J clear - Remove the pulse corrections of a servo"));
   Serial.println(F(""));
 }
 
+void printDerating(SupplyGovernor::Event event) {
+  Serial.print(F("Derating at "));
+  Serial.print(event.startMillis);
+  Serial.print(F(" ms for "));
+  Serial.print(event.durationMs);
+  Serial.print(F(" ms: "));
+  Serial.print(event.voltage, 2);
+  Serial.print(F(" V, sag "));
+  Serial.print(event.sag, 2);
+  Serial.print(F(" V, speed down to "));
+  Serial.println(event.minSpeed, 2);
+}
+
+void printEnergy(EnergyMeter::Report report) {
+  Serial.print(report.cycles);
+  Serial.print(F("\t"));
+  Serial.print(report.durationMs / 1000.0, 1);
+  Serial.print(F("\t"));
+  Serial.print(report.distance, 0);
+  Serial.print(F("\t"));
+  Serial.print(report.GetJoulesPerCycle(), 2);
+  Serial.print(F("\t"));
+  Serial.println(report.GetJoulesPerMm() * 1000, 1);
+}
+
+// Crawl until the energy meter has counted the loops, false if too many steps were rejected
+bool crawlLoops(int loops) {
+  // A loop is at most 6 steps, allow as many again that do not move
+  int maxSteps = loops * 12;
+  for (int steps = 0; damson.GetGaitEnergy().cycles < (unsigned int)loops; steps++) {
+    if (steps >= maxSteps)
+      return false;
+    damson.CrawlForward();
+  }
+  return true;
+}
+
+void runEnergyBenchmark(int cycles) {
+  Serial.println(F("group\tloops\ttime(s)\tmm\tJ/loop\tmJ/mm"));
+  for (int group = 1; group <= 3; group++) {
+    damson.SetActionGroup(group);
+    // One loop to settle into the gait, then measure
+    damson.ResetGaitEnergy();
+    bool isComplete = crawlLoops(1);
+    damson.ResetGaitEnergy();
+    isComplete = isComplete && crawlLoops(cycles);
+    Serial.print(group);
+    Serial.print(F("\t"));
+    printEnergy(damson.GetGaitEnergy());
+    if (!isComplete)
+      Serial.println(F("  stopped, the steps were rejected"));
+  }
+  damson.SetActionGroup(1);
+}
+
 void processCommand(String cmd) {
   cmd.trim();
   cmd.toLowerCase();
@@ -291,6 +358,57 @@ void processCommand(String cmd) {
       Serial.println(F("Invalid timeout value"));
     }
   }
+  else if (cmd == "outputs") {
+    Robot::OutputCounts counts = damson.GetOutputCounts(true);
+    Serial.print(F("IK solves: "));
+    Serial.print(counts.solves);
+    Serial.print(F(", skipped: "));
+    Serial.println(counts.skippedSolves);
+    Serial.print(F("Servo writes: "));
+    Serial.print(counts.servoWrites);
+    Serial.print(F(", skipped: "));
+    Serial.println(counts.skippedServoWrites);
+  }
+  else if (cmd == "heat") {
+    for (int leg = 1; leg <= 6; leg++) {
+      Serial.print(F("Leg "));
+      Serial.print(leg);
+      Serial.print(F(": hip "));
+      Serial.print((int)(damson.GetJointHeat(leg, 0) * 100));
+      Serial.print(F("%, femur "));
+      Serial.print((int)(damson.GetJointHeat(leg, 1) * 100));
+      Serial.print(F("%, tibia "));
+      Serial.print((int)(damson.GetJointHeat(leg, 2) * 100));
+      Serial.println(F("%"));
+    }
+    Serial.print(F("Speed throttle: "));
+    Serial.println(damson.GetSpeedThrottle(), 2);
+  }
+  else if (cmd == "energy") {
+    Serial.println(F("loops\ttime(s)\tmm\tJ/loop\tmJ/mm"));
+    printEnergy(damson.GetLastGaitCycle());
+  }
+  else if (cmd.startsWith("bench ")) {
+    int cycles = cmd.substring(6).toInt();
+    if (cycles >= 1 && cycles <= 50) {
+      bool wasIdle = damson.idle.IsEnabled();
+      damson.idle.SetEnabled(false);
+      runEnergyBenchmark(cycles);
+      damson.idle.SetEnabled(wasIdle);
+    } else {
+      Serial.println(F("Usage: bench N (1-50)"));
+    }
+  }
+  else if (cmd == "power") {
+    Serial.print(F("Supply: "));
+    Serial.print(damson.GetSupplyVoltage(), 2);
+    Serial.print(F(" V, speed factor: "));
+    Serial.println(damson.GetSupplySpeed(), 2);
+    Serial.print(F("Deratings: "));
+    Serial.println(damson.GetDeratingCount());
+    if (damson.GetDeratingCount() > 0)
+      printDerating(damson.GetLastDerating());
+  }
   // Motor testing: servo <leg> <joint> <angle>
   // leg: 1-6, joint: 0=A(hip), 1=B(femur), 2=C(tibia), angle: 0-180
   else if (cmd.startsWith("servo ")) {
@@ -323,14 +441,112 @@ void processCommand(String cmd) {
       Serial.println(F("  leg: 1-6, joint: 0=A(hip), 1=B(femur), 2=C(tibia), angle: 0-180"));
     }
   }
+  // Servo calibration: pulse <leg> <joint> <min us> <max us>
+  else if (cmd.startsWith("pulse ")) {
+    int firstSpace = 6;
+    int secondSpace = cmd.indexOf(' ', firstSpace);
+    int thirdSpace = cmd.indexOf(' ', secondSpace + 1);
+    int fourthSpace = cmd.indexOf(' ', thirdSpace + 1);
+
+    if (secondSpace > 0 && thirdSpace > 0 && fourthSpace > 0) {
+      int leg = cmd.substring(firstSpace, secondSpace).toInt();
+      int joint = cmd.substring(secondSpace + 1, thirdSpace).toInt();
+      long minPulse = cmd.substring(thirdSpace + 1, fourthSpace).toInt();
+      long maxPulse = cmd.substring(fourthSpace + 1).toInt();
+
+      if (minPulse > 0 && maxPulse > 0 && damson.SetServoPulseRange(leg, joint, minPulse, maxPulse)) {
+        Serial.print(F("Leg "));
+        Serial.print(leg);
+        Serial.print(F(" Joint "));
+        Serial.print(joint);
+        Serial.print(F(" pulse range "));
+        Serial.print(minPulse);
+        Serial.print(F("-"));
+        Serial.print(maxPulse);
+        Serial.println(F(" us"));
+      } else {
+        Serial.println(F("Invalid values. Use: pulse <leg 1-6> <joint 0-2> <min> <max>"));
+      }
+    } else {
+      Serial.println(F("Usage: pulse <leg> <joint> <min us> <max us>"));
+    }
+  }
+  // Servo calibration: curve <leg> <joint> clear
+  else if (cmd.startsWith("curve ") && cmd.endsWith(" clear")) {
+    int firstSpace = 6;
+    int secondSpace = cmd.indexOf(' ', firstSpace);
+    int leg = cmd.substring(firstSpace, secondSpace).toInt();
+    int joint = cmd.substring(secondSpace + 1).toInt();
+
+    if (secondSpace > 0 && damson.ClearServoCurve(leg, joint)) {
+      Serial.print(F("Leg "));
+      Serial.print(leg);
+      Serial.print(F(" Joint "));
+      Serial.print(joint);
+      Serial.println(F(" curve cleared"));
+    } else {
+      Serial.println(F("Invalid values. Use: curve <leg 1-6> <joint 0-2> clear"));
+    }
+  }
+  // Servo calibration: curve <leg> <joint> [<servo angle> <correction us>]
+  else if (cmd.startsWith("curve ")) {
+    int firstSpace = 6;
+    int secondSpace = cmd.indexOf(' ', firstSpace);
+    int thirdSpace = cmd.indexOf(' ', secondSpace + 1);
+    int fourthSpace = cmd.indexOf(' ', thirdSpace + 1);
+
+    if (secondSpace > 0 && thirdSpace > 0 && fourthSpace > 0) {
+      int leg = cmd.substring(firstSpace, secondSpace).toInt();
+      int joint = cmd.substring(secondSpace + 1, thirdSpace).toInt();
+      int angle = cmd.substring(thirdSpace + 1, fourthSpace).toInt();
+      float correction = cmd.substring(fourthSpace + 1).toFloat();
+
+      if (damson.SetServoCurvePoint(leg, joint, angle, correction)) {
+        Serial.print(F("Leg "));
+        Serial.print(leg);
+        Serial.print(F(" Joint "));
+        Serial.print(joint);
+        Serial.print(F(" pulse at "));
+        Serial.print(angle);
+        Serial.print(F(" degrees corrected by "));
+        Serial.print(correction, 1);
+        Serial.println(F(" us"));
+      } else {
+        Serial.println(F("Invalid values. Use: curve <leg 1-6> <joint 0-2> <30-150> <correction>"));
+      }
+    } else if (secondSpace > 0 && thirdSpace < 0) {
+      int leg = cmd.substring(firstSpace, secondSpace).toInt();
+      int joint = cmd.substring(secondSpace + 1).toInt();
+      if (damson.GetServoAngle(leg, joint) >= 0) {
+        Serial.print(F("Leg "));
+        Serial.print(leg);
+        Serial.print(F(" Joint "));
+        Serial.print(joint);
+        Serial.print(F(" corrections (us) at 30-150:"));
+        for (int angle = 30; angle <= 150; angle += 30) {
+          Serial.print(F(" "));
+          Serial.print(damson.GetServoCurvePoint(leg, joint, angle), 1);
+        }
+        Serial.println();
+      } else {
+        Serial.println(F("Invalid values. Use: curve <leg 1-6> <joint 0-2>"));
+      }
+    } else {
+      Serial.println(F("Usage: curve <leg> <joint> [<servo angle> <correction us> | clear]"));
+    }
+  }
   else if (cmd == "angles") {
     // Report current servo angles for all legs
     // Format: leg,hip,femur,tibia for each leg
     Serial.println(F("ANGLES:"));
-    // Note: We don't have direct access to servoAngleNow from here
-    // This would need to be added to the Robot class
-    // For now, output placeholder that web interface can parse
-    Serial.println(F("Not implemented yet - use reset to sync"));
+    for (int leg = 1; leg <= 6; leg++) {
+      Serial.print(leg);
+      for (int joint = 0; joint < 3; joint++) {
+        Serial.print(',');
+        Serial.print(damson.GetServoAngle(leg, joint), 1);
+      }
+      Serial.println();
+    }
   }
   else if (cmd == "help" || cmd == "?") {
     printHelp();
@@ -373,6 +589,13 @@ void loop() {
   // Check for idle animations
   damson.idle.Update();
 
+  // Report each derating as it starts
+  unsigned int deratings = damson.GetDeratingCount();
+  if (deratings != reportedDeratings) {
+    reportedDeratings = deratings;
+    printDerating(damson.GetLastDerating());
+  }
+
   // Read serial commands for animation testing
   while (Serial.available() > 0) {
     char c = Serial.read();
@@ -0,0 +1,474 @@
+/*
+ * File       Gait parameter optimizer for Project Damson
+ * Brief      Sweeps crawlLength, legLift and legLiftSpeed for each action group (2/4/6 steps per
+ *            loop). Every candidate runs the firmware gait code in the headless simulator on a
+ *            thread pool and is scored on ground speed, joint limit margin and smoothness.
+ *            The best set of each group is exported as ProjectDamsonGaitParams.h.
+ *
+ *            With --energy it instead walks each group with its current parameters for N loops
+ *            and compares the estimated energy per loop and per millimetre.
+ *
+ * Usage      gait_optimizer [--threads N] [--cycles N] [--min-margin DEG] [--accel-scale DEG/S^2]
+ *                           [--top N] [--out FILE]
+ *            gait_optimizer --energy N
+ *
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#include "HostSim.h"
+#include "ProjectDamsonLimits.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Options {
+  unsigned threads = std::thread::hardware_concurrency();
+  int cycles = 4;             // Measured gait loops per candidate
+  float minMargin = 5;        // Reject candidates closer than this to a servo end stop (degrees)
+  float accelScale = 100000;  // RMS joint acceleration that halves the score (deg/s^2)
+  int top = 5;
+  std::string out = "ProjectDamsonGaitParams.h";
+  int energyCycles = 0;       // Run the energy benchmark instead of the sweep
+};
+
+struct Candidate {
+  int group;
+  GaitParams params;
+};
+
+struct Result {
+  Candidate candidate;
+  bool feasible = false;
+  float distance = 0;         // Body travel over the measured loops (mm)
+  float speed = 0;            // Ground speed (mm/s)
+  float margin = 180;         // Smallest distance of any servo to the global limits (degrees)
+  float rmsAccel = 0;         // RMS joint angular acceleration (deg/s^2)
+  float score = 0;
+};
+
+// Per tick metrics, fed by the simulator observer ------------------------------------------------
+
+class GaitMetrics
+{
+public:
+  void Reset(Robot &robot)
+  {
+    Sample(robot, lastAngles);
+    hasVelocity = false;
+    sumSquaredAccel = 0;
+    accelSamples = 0;
+    margin = 180;
+    travelX = travelY = 0;
+    GetFeet(robot, lastFeet);
+  }
+
+  void Update(Robot &robot)
+  {
+    float angles[18];
+    Sample(robot, angles);
+
+    const float dt = HostSim::tickMs / 1000.0f;
+    for (int i = 0; i < 18; i++)
+    {
+      float velocity = (angles[i] - lastAngles[i]) / dt;
+      if (hasVelocity)
+      {
+        float accel = (velocity - lastVelocity[i]) / dt;
+        sumSquaredAccel += accel * accel;
+        accelSamples++;
+      }
+      lastVelocity[i] = velocity;
+      lastAngles[i] = angles[i];
+    }
+    hasVelocity = true;
+
+    UpdateMargin(robot.leg1);
+    UpdateMargin(robot.leg2);
+    UpdateMargin(robot.leg3);
+    UpdateMargin(robot.leg4);
+    UpdateMargin(robot.leg5);
+    UpdateMargin(robot.leg6);
+
+    // Feet on the ground push the body, so it moves opposite to the mean stance foot motion
+    Point feet[6];
+    GetFeet(robot, feet);
+    float lowest = feet[0].z;
+    for (int i = 1; i < 6; i++)
+      lowest = std::min(lowest, (float)feet[i].z);
+    float dx = 0, dy = 0;
+    int stance = 0;
+    for (int i = 0; i < 6; i++)
+    {
+      if (feet[i].z < lowest + stanceTolerance && lastFeet[i].z < lowest + stanceTolerance)
+      {
+        dx += feet[i].x - lastFeet[i].x;
+        dy += feet[i].y - lastFeet[i].y;
+        stance++;
+      }
+      lastFeet[i] = feet[i];
+    }
+    if (stance >= 3)
+    {
+      travelX -= dx / stance;
+      travelY -= dy / stance;
+    }
+  }
+
+  float Margin() const { return margin; }
+  float TravelY() const { return travelY; }
+  float RmsAccel() const { return accelSamples ? sqrt(sumSquaredAccel / accelSamples) : 0; }
+
+private:
+  static constexpr float stanceTolerance = 1;
+
+  float lastAngles[18];
+  float lastVelocity[18];
+  bool hasVelocity = false;
+  double sumSquaredAccel = 0;
+  long accelSamples = 0;
+  float margin = 180;
+  Point lastFeet[6];
+  float travelX = 0, travelY = 0;
+
+  static void Sample(Robot &robot, float angles[18])
+  {
+    RobotLeg *legs[6] = { &robot.leg1, &robot.leg2, &robot.leg3, &robot.leg4, &robot.leg5, &robot.leg6 };
+    for (int i = 0; i < 6; i++)
+    {
+      angles[i * 3 + 0] = legs[i]->jointA.jointAngleNow;
+      angles[i * 3 + 1] = legs[i]->jointB.jointAngleNow;
+      angles[i * 3 + 2] = legs[i]->jointC.jointAngleNow;
+    }
+  }
+
+  static void GetFeet(Robot &robot, Point feet[6])
+  {
+    RobotLegsPoints points;
+    robot.GetPointsNow(points);
+    feet[0] = points.leg1;
+    feet[1] = points.leg2;
+    feet[2] = points.leg3;
+    feet[3] = points.leg4;
+    feet[4] = points.leg5;
+    feet[5] = points.leg6;
+  }
+
+  void UpdateMargin(RobotLeg &leg)
+  {
+    UpdateMargin(leg.jointA.servoAngleNow);
+    UpdateMargin(leg.jointB.servoAngleNow);
+    UpdateMargin(leg.jointC.servoAngleNow);
+  }
+
+  void UpdateMargin(float servoAngle)
+  {
+    margin = std::min(margin, servoAngle - GlobalServoLimits::SERVO_MIN);
+    margin = std::min(margin, GlobalServoLimits::SERVO_MAX - servoAngle);
+  }
+};
+
+static void ObserveTick(Robot &robot, void *context)
+{
+  static_cast<GaitMetrics *>(context)->Update(robot);
+}
+
+// Simulation -------------------------------------------------------------------------------------
+
+static int StepsPerLoop(int group)
+{
+  return group == 3 ? 6 : group == 2 ? 4 : 2;
+}
+
+static Result Simulate(const Candidate &candidate, const Options &options)
+{
+  Result result;
+  result.candidate = candidate;
+
+  std::unique_ptr<RobotAction> action(new RobotAction());
+  HostSim::Begin(*action);
+
+  action->Start();
+  action->SetActionGroup(candidate.group);
+  action->SetGaitParams(candidate.params);
+  action->ActiveMode();
+
+  // One loop to leave the neutral stance, then measure steady state walking
+  int steps = StepsPerLoop(candidate.group);
+  for (int i = 0; i < steps; i++)
+    action->CrawlForward();
+
+  GaitMetrics metrics;
+  metrics.Reset(action->robot);
+  HostSim::SetObserver(ObserveTick, &metrics);
+  unsigned long startMillis = HostSim::Millis();
+
+  for (int i = 0; i < steps * options.cycles; i++)
+    action->CrawlForward();
+
+  float seconds = (HostSim::Millis() - startMillis) / 1000.0f;
+  bool overrun = HostSim::IsOverrun();
+  HostSim::End();
+
+  result.distance = metrics.TravelY();
+  result.speed = seconds > 0 ? result.distance / seconds : 0;
+  result.margin = metrics.Margin();
+  result.rmsAccel = metrics.RmsAccel();
+
+  // A step whose points fail the reachability checks is skipped silently by the firmware,
+  // so require most of the commanded distance to be covered
+  float commanded = candidate.params.crawlLength * options.cycles;
+  result.feasible = !overrun && result.distance > commanded * 0.9f && result.margin >= options.minMargin;
+  if (result.feasible)
+    result.score = result.speed / (1 + result.rmsAccel / options.accelScale);
+
+  return result;
+}
+
+// Energy benchmark -------------------------------------------------------------------------------
+
+// Crawl until the energy meter has counted the loops, false if too many steps were rejected
+static bool CrawlLoops(RobotAction &action, int cycles)
+{
+  // A loop is at most 6 steps, allow as many again that do not move
+  int maxSteps = cycles * 12;
+  for (int steps = 0; action.robot.GetGaitEnergy().cycles < (unsigned)cycles; steps++)
+  {
+    if (steps >= maxSteps)
+      return false;
+    action.CrawlForward();
+  }
+  return true;
+}
+
+static EnergyMeter::Report SimulateEnergy(int group, int cycles, bool &complete)
+{
+  std::unique_ptr<RobotAction> action(new RobotAction());
+  HostSim::Begin(*action);
+
+  action->Start();
+  action->SetActionGroup(group);
+  action->ActiveMode();
+
+  // Same as the robot benchmark, one loop to settle into the gait
+  action->robot.ResetGaitEnergy();
+  complete = CrawlLoops(*action, 1);
+  action->robot.ResetGaitEnergy();
+  complete = complete && CrawlLoops(*action, cycles);
+
+  EnergyMeter::Report report = action->robot.GetGaitEnergy();
+  HostSim::End();
+  return report;
+}
+
+static void RunEnergyBenchmark(int cycles)
+{
+  printf("Energy of %d loops per action group, at the simulated supply voltage\n", cycles);
+  printf("  group  loops  time(s)  distance(mm)  J/loop  mJ/mm  power(W)\n");
+  for (int group = 1; group <= 3; group++)
+  {
+    bool complete;
+    EnergyMeter::Report report = SimulateEnergy(group, cycles, complete);
+    float seconds = report.durationMs / 1000.0f;
+    printf("  %5d  %5u  %7.1f  %12.1f  %6.2f  %5.1f  %8.2f%s\n",
+           group, report.cycles, seconds, report.distance, report.GetJoulesPerCycle(),
+           report.GetJoulesPerMm() * 1000, seconds > 0 ? report.joules / seconds : 0,
+           complete ? "" : "  stopped, the steps were rejected");
+  }
+}
+
+static std::vector<Result> RunAll(const std::vector<Candidate> &candidates, const Options &options)
+{
+  std::vector<Result> results(candidates.size());
+  std::atomic<size_t> next(0);
+  std::atomic<size_t> done(0);
+
+  auto worker = [&]() {
+    for (size_t i = next++; i < candidates.size(); i = next++)
+    {
+      results[i] = Simulate(candidates[i], options);
+      size_t finished = ++done;
+      if (finished % 100 == 0 || finished == candidates.size())
+        fprintf(stderr, "\r%zu / %zu candidates", finished, candidates.size());
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < std::max(1u, options.threads); i++)
+    pool.emplace_back(worker);
+  for (auto &thread : pool)
+    thread.join();
+  fprintf(stderr, "\n");
+
+  return results;
+}
+
+static std::vector<Candidate> MakeSweep()
+{
+  std::vector<Candidate> candidates;
+  for (int group = 1; group <= 3; group++)
+    for (float crawlLength = 24; crawlLength <= 60; crawlLength += 4)
+      for (float legLift = 10; legLift <= 30; legLift += 5)
+        for (float legLiftSpeed = 4; legLiftSpeed <= 12; legLiftSpeed += 1)
+          candidates.push_back({ group, { crawlLength, legLift, legLiftSpeed } });
+  return candidates;
+}
+
+// Output -----------------------------------------------------------------------------------------
+
+static void PrintTable(const std::vector<Result> &ranked, int group, int top)
+{
+  printf("\nAction group %d (%d steps per loop)\n", group, StepsPerLoop(group));
+  printf("  crawlLength  legLift  legLiftSpeed  speed(mm/s)  margin(deg)  rmsAccel(deg/s^2)  score\n");
+  int printed = 0;
+  for (const Result &r : ranked)
+  {
+    if (r.candidate.group != group || !r.feasible)
+      continue;
+    printf("  %11.1f  %7.1f  %12.1f  %11.1f  %11.1f  %17.0f  %5.1f\n",
+           r.candidate.params.crawlLength, r.candidate.params.legLift, r.candidate.params.legLiftSpeed,
+           r.speed, r.margin, r.rmsAccel, r.score);
+    if (++printed == top)
+      break;
+  }
+  if (printed == 0)
+    printf("  no feasible candidate\n");
+}
+
+static void WriteGroup(FILE *file, int group, const char *description, const Result *best)
+{
+  GaitParams params = best ? best->candidate.params : GaitParamSets::getGroup(group);
+  fprintf(file, "  // Action group %d - %s\n", group, description);
+  if (best)
+    fprintf(file, "  // speed %.1f mm/s, margin %.1f deg, rms joint accel %.0f deg/s^2\n",
+            best->speed, best->margin, best->rmsAccel);
+  fprintf(file, "  constexpr GaitParams group%d = { %g, %g, %g };\n\n",
+          group, params.crawlLength, params.legLift, params.legLiftSpeed);
+}
+
+static bool WriteHeader(const std::string &path, const Result *best[4])
+{
+  FILE *file = fopen(path.c_str(), "w");
+  if (file == nullptr)
+    return false;
+
+  fprintf(file,
+          "/*\n"
+          " * File       Gait parameters for Project Damson\n"
+          " * Project    Project Damson\n"
+          " * Brief      Crawl parameters for each action group.\n"
+          " *            This file can be regenerated by Damson/tools/GaitOptimizer, which sweeps the\n"
+          " *            parameters in a headless simulation of the gait code and exports the best sets.\n"
+          " * License    Creative Commons Attribution ShareAlike 3.0\n"
+          " *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)\n"
+          " * -----------------------------------------------------------------------------------------------*/\n"
+          "\n"
+          "#pragma once\n"
+          "\n"
+          "struct GaitParams {\n"
+          "  float crawlLength;   // Distance covered by one whole gait loop (mm)\n"
+          "  float legLift;       // Height a swinging foot is lifted (mm)\n"
+          "  float legLiftSpeed;  // Step distance of the swinging legs per control tick (mm)\n"
+          "};\n"
+          "\n"
+          "// =============================================================================\n"
+          "// PARAMETER SETS (per action group)\n"
+          "// =============================================================================\n"
+          "// Format: { crawlLength, legLift, legLiftSpeed }\n"
+          "\n"
+          "namespace GaitParamSets {\n"
+          "\n");
+
+  WriteGroup(file, 1, "2 steps per loop (tripod)", best[1]);
+  WriteGroup(file, 2, "4 steps per loop (ripple)", best[2]);
+  WriteGroup(file, 3, "6 steps per loop (wave)", best[3]);
+
+  fprintf(file,
+          "  // Helper to get parameters by action group (1-3)\n"
+          "  inline const GaitParams& getGroup(int group) {\n"
+          "    switch (group) {\n"
+          "      case 2: return group2;\n"
+          "      case 3: return group3;\n"
+          "      default: return group1;\n"
+          "    }\n"
+          "  }\n"
+          "\n"
+          "}  // namespace GaitParamSets\n");
+
+  fclose(file);
+  return true;
+}
+
+static bool ParseOptions(int argc, char *argv[], Options &options)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "--threads") && hasValue)
+      options.threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--cycles") && hasValue)
+      options.cycles = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "--min-margin") && hasValue)
+      options.minMargin = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--accel-scale") && hasValue)
+      options.accelScale = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--top") && hasValue)
+      options.top = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--out") && hasValue)
+      options.out = argv[++i];
+    else if (!strcmp(argv[i], "--energy") && hasValue)
+      options.energyCycles = std::max(1, atoi(argv[++i]));
+    else
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  Options options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    fprintf(stderr, "Usage: %s [--threads N] [--cycles N] [--min-margin DEG] [--accel-scale DEG/S^2] [--top N] [--out FILE]\n"
+                    "       %s --energy N\n", argv[0], argv[0]);
+    return 2;
+  }
+
+  if (options.energyCycles > 0)
+  {
+    RunEnergyBenchmark(options.energyCycles);
+    return 0;
+  }
+
+  std::vector<Candidate> candidates = MakeSweep();
+  fprintf(stderr, "Simulating %zu candidates, %d loops each, on %u threads\n",
+          candidates.size(), options.cycles, std::max(1u, options.threads));
+
+  std::vector<Result> ranked = RunAll(candidates, options);
+  std::stable_sort(ranked.begin(), ranked.end(), [](const Result &a, const Result &b) {
+    return a.score > b.score;
+  });
+
+  const Result *best[4] = {};
+  for (const Result &r : ranked)
+    if (r.feasible && best[r.candidate.group] == nullptr)
+      best[r.candidate.group] = &r;
+
+  for (int group = 1; group <= 3; group++)
+    PrintTable(ranked, group, options.top);
+
+  if (!WriteHeader(options.out, best))
+  {
+    fprintf(stderr, "Failed to write %s\n", options.out.c_str());
+    return 1;
+  }
+  printf("\nWrote %s\n", options.out.c_str());
+  return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * File       Headless kinematic simulator for Project Damson
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#include "HostSim.h"
+
+#include <string.h>
+
+namespace {
+
+  struct SimState {
+    Robot *robot = nullptr;
+    unsigned long millis = 0;
+    unsigned long ticks = 0;
+    bool overrun = false;
+    void (*observer)(Robot &robot, void *context) = nullptr;
+    void *observerContext = nullptr;
+    uint8_t eeprom[4096];
+  };
+
+  thread_local SimState sim;
+
+  // Product version 2 board, no stored servo offsets
+  const uint8_t eepromDataFormatVersion = 20;
+
+  // ADC reading of a 7.4 V battery through the version 2 divider and reference
+  const int supplyVoltageReading = 881;
+
+}
+
+void HostSim::Begin(RobotAction &action)
+{
+  sim = SimState();
+  memset(sim.eeprom, 0, sizeof(sim.eeprom));
+  sim.eeprom[(int)EepromAddresses::dataFormatVersion] = eepromDataFormatVersion;
+  sim.robot = &action.robot;
+}
+
+void HostSim::End()
+{
+  sim.robot = nullptr;
+  sim.observer = nullptr;
+}
+
+void HostSim::Tick()
+{
+  if (sim.robot == nullptr)
+    return;
+
+  sim.millis = (sim.millis / tickMs + 1) * tickMs;
+  if (++sim.ticks > maxTicks)
+  {
+    // Release every blocked wait so a runaway simulation terminates
+    sim.overrun = true;
+    sim.robot->leg1.isBusy = sim.robot->leg2.isBusy = sim.robot->leg3.isBusy = false;
+    sim.robot->leg4.isBusy = sim.robot->leg5.isBusy = sim.robot->leg6.isBusy = false;
+    return;
+  }
+
+  sim.robot->Update();
+
+  if (sim.observer != nullptr)
+    sim.observer(*sim.robot, sim.observerContext);
+}
+
+void HostSim::SetObserver(void (*observer)(Robot &robot, void *context), void *context)
+{
+  sim.observer = observer;
+  sim.observerContext = context;
+}
+
+unsigned long HostSim::Millis() { return sim.millis; }
+unsigned long HostSim::Ticks() { return sim.ticks; }
+bool HostSim::IsOverrun() { return sim.overrun; }
+
+// Firmware hook, see Robot::WaitUntilFree()
+void HostSimWait()
+{
+  HostSim::Tick();
+}
+
+// Arduino core shim -----------------------------------------------------------------------------
+
+unsigned long millis() { return sim.millis; }
+unsigned long micros() { return sim.millis * 1000; }
+
+void delay(unsigned long ms)
+{
+  unsigned long end = sim.millis + ms;
+  while ((sim.millis / HostSim::tickMs + 1) * HostSim::tickMs <= end && !sim.overrun)
+    HostSim::Tick();
+  sim.millis = end;
+}
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+void analogReference(uint8_t) {}
+
+int analogRead(uint8_t pin)
+{
+  return pin == A7 ? supplyVoltageReading : 512;
+}
+
+EEPROMClass EEPROM;
+
+uint8_t EEPROMClass::read(int address)
+{
+  return sim.eeprom[address & (sizeof(sim.eeprom) - 1)];
+}
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+  sim.eeprom[address & (sizeof(sim.eeprom) - 1)] = value;
+}
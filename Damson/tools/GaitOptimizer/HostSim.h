@@ -0,0 +1,35 @@
+/*
+ * File       Headless kinematic simulator for Project Damson
+ * Brief      Runs the firmware gait code (RobotAction) on the host.
+ *            The 20 ms control tick that FlexiTimer2 drives on the robot is advanced whenever the
+ *            firmware blocks, in Robot::WaitUntilFree() or delay(). All state is per thread, so
+ *            independent simulations can run in parallel.
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "ProjectDamsonBasic.h"
+
+class HostSim
+{
+public:
+  static constexpr unsigned long tickMs = 20;
+  static constexpr unsigned long maxTicks = 200000;  // Guard against gait code that never settles
+
+  // Bind a robot to the calling thread and reset the simulated clock and EEPROM
+  static void Begin(RobotAction &action);
+  static void End();
+
+  // Advance one control tick
+  static void Tick();
+
+  // Called after every tick, used to collect metrics
+  static void SetObserver(void (*observer)(Robot &robot, void *context), void *context);
+
+  static unsigned long Millis();
+  static unsigned long Ticks();
+  static bool IsOverrun();
+};
@@ -0,0 +1,115 @@
+/*
+ * File       Host stand-in for the servo driver of the Damson host simulator
+ * Project    Project Damson
+ * Brief      Keeps the pulse of each channel instead of driving timers.
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#include "ProjectDamsonServoDriver.h"
+
+namespace {
+
+  thread_local unsigned int ticks[ServoDriver::maxChannels];
+  thread_local bool isAttached[ServoDriver::maxChannels];
+  thread_local ServoCurve curves[ServoDriver::maxChannels];
+  thread_local unsigned long writeCount = 0;
+  thread_local unsigned long skippedWriteCount = 0;
+
+}
+
+byte ServoDriver::Attach(byte pin)
+{
+  // A fixed channel per pin, as every simulated robot attaches its servos again
+  byte channel = pin % maxChannels;
+  isAttached[channel] = true;
+  ticks[channel] = 0;
+  SetPulseRange(channel, defaultMinPulse, defaultMaxPulse);
+  return channel;
+}
+
+void ServoDriver::Detach(byte channel)
+{
+  WriteTicks(channel, 0);
+}
+
+bool ServoDriver::IsAttached(byte channel)
+{
+  return channel < maxChannels && isAttached[channel];
+}
+
+void ServoDriver::SetPulseRange(byte channel, unsigned int minPulse, unsigned int maxPulse)
+{
+  if (!IsAttached(channel))
+    return;
+
+  minPulse = constrain(minPulse, ServoDriver::minPulse, ServoDriver::maxPulse);
+  maxPulse = constrain(maxPulse, minPulse, ServoDriver::maxPulse);
+  ServoCurve curve;
+  curve.SetLinear(minPulse * ticksPerMicrosecond, maxPulse * ticksPerMicrosecond);
+  SetPulseCurve(channel, curve);
+}
+
+void ServoDriver::SetPulseCurve(byte channel, const ServoCurve &curve)
+{
+  if (IsAttached(channel))
+    curves[channel] = curve;
+}
+
+void ServoDriver::Write(byte channel, float angle)
+{
+  angle = constrain(angle, 0, 180);
+  WriteCentidegrees(channel, (int)(angle * centidegreesPerDegree + 0.5));
+}
+
+void ServoDriver::WriteCentidegrees(byte channel, int centidegrees)
+{
+  if (!IsAttached(channel))
+    return;
+
+  centidegrees = constrain(centidegrees, 0, 180 * centidegreesPerDegree);
+  WriteTicks(channel, curves[channel].GetTicks(centidegrees));
+}
+
+void ServoDriver::WriteMicroseconds(byte channel, float microseconds)
+{
+  microseconds = constrain(microseconds, minPulse, maxPulse);
+  WriteTicks(channel, (unsigned int)(microseconds * ticksPerMicrosecond + 0.5));
+}
+
+void ServoDriver::WriteTicks(byte channel, unsigned int ticks)
+{
+  if (!IsAttached(channel))
+    return;
+
+  if (::ticks[channel] == ticks)
+  {
+    skippedWriteCount++;
+  }
+  else
+  {
+    ::ticks[channel] = ticks;
+    writeCount++;
+  }
+}
+
+unsigned int ServoDriver::ReadTicks(byte channel)
+{
+  return IsAttached(channel) ? ticks[channel] : 0;
+}
+
+unsigned long ServoDriver::GetWriteCount()
+{
+  return writeCount;
+}
+
+unsigned long ServoDriver::GetSkippedWriteCount()
+{
+  return skippedWriteCount;
+}
+
+void ServoDriver::ResetWriteCounts()
+{
+  writeCount = 0;
+  skippedWriteCount = 0;
+}
@@ -0,0 +1,15 @@
+#!/bin/sh
+# Build script for the Damson gait optimizer (Linux)
+# Compiles the firmware gait code against the host shims in ./shim
+
+cd "$(dirname "$0")"
+
+LIB=../../arduino/libraries/ProjectDamson/src
+
+g++ -std=gnu++17 -O2 -pthread \
+    -DARDUINO_AVR_MEGA2560 -DDAMSON_HOST_SIM \
+    -Ishim -I"$LIB" -I. \
+    GaitOptimizer.cpp HostSim.cpp ServoDriverSim.cpp "$LIB/ProjectDamsonServoCurve.cpp" "$LIB/ProjectDamsonBasic.cpp" "$LIB/ProjectDamsonStability.cpp" "$LIB/ProjectDamsonFootstep.cpp" "$LIB/ProjectDamsonBodyPose.cpp" "$LIB/ProjectDamsonThermal.cpp" "$LIB/ProjectDamsonCollision.cpp" "$LIB/ProjectDamsonGovernor.cpp" "$LIB/ProjectDamsonEnergy.cpp" \
+    -o gait_optimizer || exit 1
+
+echo "Built $(pwd)/gait_optimizer"
@@ -0,0 +1,56 @@
+/*
+ * File       Host shim of the Arduino core for the Damson host simulator
+ * Brief      Provides just enough of the Arduino API to compile ProjectDamsonBasic.cpp on Linux.
+ *            Time is simulated per thread, see HostSim.h.
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <type_traits>
+
+typedef uint8_t byte;
+
+#define PI 3.1415926535897932384626433832795
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define DEFAULT 1
+#define EXTERNAL 0
+
+#define A0 54
+#define A1 55
+#define A6 60
+#define A7 61
+#define A8 62
+#define A13 67
+#define A14 68
+#define A15 69
+
+// Each simulated robot runs in one thread, there are no interrupts to hold off
+#define interrupts()
+#define noInterrupts()
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+template <class A, class B>
+inline typename std::common_type<A, B>::type min(A a, B b) { return a < b ? a : b; }
+template <class A, class B>
+inline typename std::common_type<A, B>::type max(A a, B b) { return a > b ? a : b; }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int analogRead(uint8_t pin);
+void analogReference(uint8_t mode);
@@ -0,0 +1,21 @@
+/*
+ * File       Host shim of the Arduino EEPROM library for the Damson host simulator
+ * Brief      Every simulator thread has its own EEPROM image, see HostSim.h.
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <stdint.h>
+
+class EEPROMClass
+{
+public:
+  uint8_t read(int address);
+  void write(int address, uint8_t value);
+  void update(int address, uint8_t value) { write(address, value); }
+};
+
+extern EEPROMClass EEPROM;
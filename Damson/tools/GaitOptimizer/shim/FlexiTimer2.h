@@ -0,0 +1,15 @@
+/*
+ * File       Host shim of the FlexiTimer2 library for the Damson host simulator
+ * Brief      The simulator drives the control tick itself, so the timer is a no-op.
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+namespace FlexiTimer2 {
+  inline void set(unsigned long, void (*)()) {}
+  inline void start() {}
+  inline void stop() {}
+}
@@ -0,0 +1,320 @@
+/*
+ * File       ESP8266 receive benchmark for Project Damson
+ * Brief      Feeds AT firmware output to the firmware IpdParser and to a model of the String based
+ *            receive loop it replaced, checks that both pick out the same data and compares the
+ *            time, heap allocations and bytes scanned per received byte.
+ *            The traffic is a capture of the ESP8266 serial output (raw bytes, as read from Serial2)
+ *            or, without one, a session built in the same format: connects, legacy and v2 orders
+ *            split over several +IPD, send prompts, SEND OK and closes.
+ *
+ * Usage      ipd_benchmark [--capture FILE] [--orders N] [--repeat N]
+ *
+ * Project    Project Damson
+ * License    Creative Commons Attribution ShareAlike 3.0
+ *            (http://creativecommons.org/licenses/by-sa/3.0/legalcode)
+ * -----------------------------------------------------------------------------------------------*/
+
+#include "ProjectDamsonIpd.h"
+#include "ProjectDamsonOrders.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+struct Options {
+  std::string capture;
+  int orders = 20000;         // Orders in the built session
+  int repeat = 20;            // Passes over the traffic, the fastest is reported
+};
+
+struct Received {
+  std::vector<byte> data;     // Data bytes in order
+  std::vector<byte> linkIds;  // Link of each byte
+};
+
+struct Cost {
+  double nsPerByte = 0;
+  unsigned long allocations = 0;
+  unsigned long scannedBytes = 0;
+};
+
+static void AddText(std::vector<byte> &traffic, const char *text)
+{
+  traffic.insert(traffic.end(), text, text + strlen(text));
+}
+
+static void AddIpd(std::vector<byte> &traffic, int linkId, const std::vector<byte> &data, size_t start, size_t length)
+{
+  char header[24];
+  snprintf(header, sizeof(header), "\r\n+IPD,%d,%u:", linkId, (unsigned)length);
+  AddText(traffic, header);
+  traffic.insert(traffic.end(), data.begin() + start, data.begin() + start + length);
+}
+
+// A response of the robot, as the module echoes it
+static void AddSend(std::vector<byte> &traffic, int linkId, int length)
+{
+  char text[96];
+  snprintf(text, sizeof(text), "AT+CIPSEND=%d,%d\r\n\r\nOK\r\n> \r\nRecv %d bytes\r\n\r\nSEND OK\r\n", linkId, length, length);
+  AddText(traffic, text);
+}
+
+static std::vector<byte> BuildSession(int orders)
+{
+  std::mt19937 random(1);
+  std::vector<byte> traffic;
+  AddText(traffic, "0,CONNECT\r\n");
+
+  for (int i = 0; i < orders; i++)
+  {
+    int linkId = (i / 500) % 2;
+    if (i % 500 == 0 && i > 0)
+    {
+      char text[32];
+      snprintf(text, sizeof(text), "%d,CLOSED\r\n%d,CONNECT\r\n", 1 - linkId, linkId);
+      AddText(traffic, text);
+    }
+
+    std::vector<byte> order;
+    if (i % 3 == 0)
+    {
+      // Legacy: 7-bit values between transStart and transEnd
+      order.push_back((byte)Orders::transStart);
+      order.push_back((byte)Orders::requestMoveBody);
+      for (int p = 0; p < 3; p++)
+        order.push_back(random() % 128);
+      order.push_back((byte)Orders::transEnd);
+    }
+    else
+    {
+      // v2: a COBS frame between zeros, any byte in it
+      order.push_back((byte)Orders::frameDelimiter);
+      int length = 4 + random() % 20;
+      for (int p = 0; p < length; p++)
+        order.push_back(1 + random() % 255);
+      order.push_back((byte)Orders::frameDelimiter);
+    }
+
+    // The module splits what arrives close together or far apart as it likes
+    size_t start = 0;
+    while (start < order.size())
+    {
+      size_t length = std::min(order.size() - start, (size_t)(1 + random() % order.size()));
+      AddIpd(traffic, linkId, order, start, length);
+      start += length;
+    }
+    AddSend(traffic, linkId, 3 + random() % 8);
+    if (i % 97 == 0)
+      AddText(traffic, "busy p...\r\n");
+  }
+  return traffic;
+}
+
+static bool ReadCapture(const std::string &path, std::vector<byte> &traffic)
+{
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+  byte buffer[4096];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    traffic.insert(traffic.end(), buffer, buffer + count);
+  fclose(file);
+  return true;
+}
+
+// Arduino String as the replaced loop used it: one realloc per appended char, indexOf by strstr
+class LegacyString {
+public:
+  ~LegacyString() { free(buffer); }
+
+  void Append(char c)
+  {
+    buffer = (char *)realloc(buffer, length + 2);
+    allocations++;
+    buffer[length++] = c;
+    buffer[length] = 0;
+  }
+
+  int IndexOf(const char *text, int from = 0)
+  {
+    scannedBytes += length - from;
+    const char *found = strstr(buffer + from, text);
+    return found ? found - buffer : -1;
+  }
+
+  bool EndsWith(char c) { return length > 0 && buffer[length - 1] == c; }
+
+  long ToInt(int start, int end)
+  {
+    std::string text(buffer + start, buffer + end);
+    return atol(text.c_str());
+  }
+
+  int Length() { return length; }
+
+  unsigned long allocations = 0;
+  unsigned long scannedBytes = 0;
+
+private:
+  char *buffer = nullptr;
+  int length = 0;
+};
+
+// The replaced Communication::ReceiveDataESP8266(), one line or one +IPD per call
+static bool ReceiveLegacy(const std::vector<byte> &traffic, size_t &position, Received &received, Cost &cost)
+{
+  LegacyString command;
+
+  while (position < traffic.size())
+  {
+    byte inByte = traffic[position++];
+    command.Append((char)inByte);
+
+    if (command.IndexOf("+IPD") != -1)
+    {
+      if (inByte == ':')
+        break;
+    }
+    else
+    {
+      if (inByte == '\n')
+        break;
+    }
+  }
+
+  bool isData = false;
+  if (command.IndexOf("+IPD") != -1 && command.EndsWith(':'))
+  {
+    int idStart = command.IndexOf(",", command.IndexOf("+IPD")) + 1;
+    int lengthStart = command.IndexOf(",", idStart) + 1;
+    byte linkId = command.ToInt(idStart, lengthStart - 1);
+    long length = command.ToInt(lengthStart, command.Length() - 1);
+    for (long i = 0; i < length && position < traffic.size(); i++)
+    {
+      received.data.push_back(traffic[position++]);
+      received.linkIds.push_back(linkId);
+    }
+    isData = true;
+  }
+
+  cost.allocations += command.allocations;
+  cost.scannedBytes += command.scannedBytes;
+  return isData;
+}
+
+static Received RunLegacy(const std::vector<byte> &traffic, int repeat, Cost &cost)
+{
+  Received received;
+  double best = 1e30;
+  for (int r = 0; r < repeat; r++)
+  {
+    Received pass;
+    Cost passCost;
+    auto start = std::chrono::steady_clock::now();
+    size_t position = 0;
+    while (position < traffic.size())
+      ReceiveLegacy(traffic, position, pass, passCost);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (seconds < best)
+      best = seconds;
+    received = pass;
+    cost.allocations = passCost.allocations;
+    cost.scannedBytes = passCost.scannedBytes;
+  }
+  cost.nsPerByte = best * 1e9 / traffic.size();
+  return received;
+}
+
+static Received RunParser(const std::vector<byte> &traffic, int repeat, Cost &cost)
+{
+  Received received;
+  double best = 1e30;
+  for (int r = 0; r < repeat; r++)
+  {
+    Received pass;
+    pass.data.reserve(traffic.size());
+    pass.linkIds.reserve(traffic.size());
+    IpdParser parser;
+    auto start = std::chrono::steady_clock::now();
+    for (byte inByte : traffic)
+    {
+      if (parser.Parse(inByte) == IpdParser::Data)
+      {
+        pass.data.push_back(inByte);
+        pass.linkIds.push_back(parser.GetLinkId());
+      }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (seconds < best)
+      best = seconds;
+    received = pass;
+  }
+  cost.nsPerByte = best * 1e9 / traffic.size();
+  cost.scannedBytes = traffic.size();
+  return received;
+}
+
+static void PrintUsage()
+{
+  printf("Usage: ipd_benchmark [--capture FILE] [--orders N] [--repeat N]\n");
+}
+
+int main(int argc, char **argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--capture" && hasValue)
+      options.capture = argv[++i];
+    else if (arg == "--orders" && hasValue)
+      options.orders = std::max(1, atoi(argv[++i]));
+    else if (arg == "--repeat" && hasValue)
+      options.repeat = std::max(1, atoi(argv[++i]));
+    else
+    {
+      PrintUsage();
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  std::vector<byte> traffic;
+  if (!options.capture.empty())
+  {
+    if (!ReadCapture(options.capture, traffic))
+    {
+      fprintf(stderr, "Can not read %s\n", options.capture.c_str());
+      return 1;
+    }
+    printf("Capture %s: %zu bytes\n", options.capture.c_str(), traffic.size());
+  }
+  else
+  {
+    traffic = BuildSession(options.orders);
+    printf("Built session: %d orders, %zu bytes\n", options.orders, traffic.size());
+  }
+
+  Cost legacyCost, parserCost;
+  Received legacy = RunLegacy(traffic, options.repeat, legacyCost);
+  Received parser = RunParser(traffic, options.repeat, parserCost);
+
+  bool isSame = legacy.data == parser.data && legacy.linkIds == parser.linkIds;
+  printf("Data bytes: legacy %zu, parser %zu, %s\n", legacy.data.size(), parser.data.size(),
+         isSame ? "identical" : "DIFFERENT");
+
+  double bytes = traffic.size();
+  printf("\n  receiver       ns/byte  allocs/byte  scanned/byte\n");
+  printf("  String loop  %9.2f  %11.3f  %12.2f\n", legacyCost.nsPerByte,
+         legacyCost.allocations / bytes, legacyCost.scannedBytes / bytes);
+  printf("  IpdParser    %9.2f  %11.3f  %12.2f\n", parserCost.nsPerByte,
+         parserCost.allocations / bytes, parserCost.scannedBytes / bytes);
+  printf("\nSpeed-up %.1fx\n", legacyCost.nsPerByte / parserCost.nsPerByte);
+
+  return isSame ? 0 : 2;
+}
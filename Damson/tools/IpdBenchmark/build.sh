@@ -0,0 +1,15 @@
+#!/bin/sh
+# Build script for the Damson ESP8266 receive benchmark (Linux)
+# Compiles the firmware +IPD parser against the host shims of the gait optimizer
+
+cd "$(dirname "$0")"
+
+LIB=../../arduino/libraries/ProjectDamson/src
+
+g++ -std=gnu++17 -O2 \
+    -DARDUINO_AVR_MEGA2560 -DDAMSON_HOST_SIM \
+    -I../GaitOptimizer/shim -I"$LIB" \
+    IpdBenchmark.cpp "$LIB/ProjectDamsonIpd.cpp" \
+    -o ipd_benchmark || exit 1
+
+echo "Built $(pwd)/ipd_benchmark"